@@ -16,11 +16,25 @@
 #endif
 
 #include <sdliv_log.h>
+#include <sdliv_util.h>
+#include <sdliv_perf.h>
 
+#include <cstdio>
 #include <map>
 #include <string>
 #include <filesystem>
 #include <set>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 
 
@@ -36,15 +50,122 @@
  *		Element objects are meaningless without the associated Window,
  *			so Elements should be created and destroyed by the associated Window
  *		Drawing of elements is handled in layers
+ *		viewElement() zooms and pans by cropping an element's src_rect
+ *			to what fits in the window, so only visible pixels get sampled
  *
  *	Element objects wrap a texture that can be drawn into a window
  *		can be created from a file path or an SDL_Surface or text
  *		Elements should be created and destroyed by the associated window
+ *		once the texture is uploaded the surface is freed if the element
+ *			knows a file to decode it from again, so a cached image costs
+ *			texture memory only; getSurface() brings the pixels back
+ *		Window::restoreTextures() recreates textures after the renderer
+ *			loses them
+ *		shrunk to fit, an Element draws from a copy the Loader area
+ *			resampled to exactly the drawn size, when it has one, rather
+ *			than leaving the minification to the renderer
+ *
+ *	TexturePool keeps released streaming textures for reuse, one per Window
+ *		textures are matched on width, height and format, so flipping
+ *			through photos of one size recycles the same few textures
+ *			instead of creating and destroying one per image
+ *		Elements upload into them with a lock and memcpy
+ *		idle textures beyond a byte budget are destroyed, oldest first
+ *
+ *	TiledElement is an Element for images too big for one texture
+ *		keeps the pixels and cuts textures from them a tile at a time,
+ *			from a smaller mip level when drawn scaled down
+ *		only tiles under src_rect get uploaded, least recently drawn
+ *			tiles are destroyed to stay within a byte budget
+ *		Window::createElementFor() picks it when the renderer needs it
  *
  *	Font objects render input text to an SDL_Surface
  *		each font object renders a specific font at a specific font size
  *		Font::Init() initializes the font rendering subsystem
  *		create a Font object with Font::openFont(window,path,size)
+ *		keeps a GlyphAtlas per colour for TextElements to draw from
+ *
+ *	GlyphAtlas packs each glyph of one font in one colour into a shared
+ *		texture the first time it's asked for, growing it as needed
+ *		layout() turns text into quads of that texture, no rasterising
+ *			or texture allocation once its glyphs have been seen
+ *
+ *	TextElement is an Element that draws text from its Font's atlas
+ *		setText() lays it out only when the text changes, draw() is one
+ *			SDL_RenderGeometry() call for the whole string
+ *		Window::createTextElement(font, layer) makes one
+ *
+ *	Decoder turns a file into an SDL_Surface no bigger than needed
+ *		JPEGs are decoded at 1/2, 1/4 or 1/8 size by libjpeg's scaled IDCT,
+ *			anything else is box filtered down after IMG_Load
+ *		decodeInto() writes JPEG rows straight into a locked texture,
+ *			Element::createFromDecoder() uses it to skip the surface
+ *		the Element is told the full size so zoom still works in full
+ *			size pixels, and FileHandler asks for a full decode once the
+ *			view is zoomed in past what the reduced one can show
+ *
+ *	Loader decodes image files on a pool of background threads
+ *		finished SDL_Surfaces are handed back to the main thread as
+ *			SDL user events, since textures must be created there
+ *		workers also convert them to the renderer's native format, so
+ *			the main thread's upload is a straight copy
+ *		Loader::init() starts the workers, Loader::quit() joins them
+ *
+ *	ImageCache keeps decoded Elements for recently viewed files
+ *		keyed by path, mtime and size so edited files miss
+ *		evicts least recently used entries to stay within byte budgets
+ *		owns its Elements, clear() it before deleting the Window
+ *
+ *	DirectoryWatcher follows changes to the working directory with inotify
+ *		runs on its own thread and posts each change as an SDL user event
+ *		FileHandler applies the changes to tracked_files as they arrive
+ *		not available on Windows, FileHandler falls back to polling there
+ *
+ *	DirectoryScanner lists a directory on a background thread
+ *		optionally recursive, with several threads sharing a stack of
+ *			directories still to list
+ *		posts the files it finds in growing batches as SDL user events
+ *		FileHandler merges each batch into tracked_files while the user
+ *			is already browsing, so first paint doesn't wait for the scan
+ *
+ *	ThumbnailStore keeps small ARGB thumbnails on disk under
+ *		$XDG_CACHE_HOME/sdliv, one container file per directory
+ *		a container is a header, an index sorted by path hash and the raw
+ *			pixels, so a whole directory's thumbnails are one mmap away
+ *		a low priority thread generates missing thumbnails and rewrites
+ *			the container under a lock, renaming a temp file into place so
+ *			other sdliv processes always map a complete file
+ *		not available on Windows
+ *
+ *	GridView shows the tracked files as a scrolling sheet of thumbnails
+ *		draws only the cells on screen, from a fixed pool of Elements
+ *			sized to the window, never one per file
+ *		each pool Element holds a streaming texture that is overwritten
+ *			with the next thumbnail when its cell scrolls into view
+ *
+ *	Hud overlays frame time, decode and upload times, cache and Loader
+ *		state and the file position, toggled with 'h'
+ *		each field is a TextElement in the window's hud_layer, laid out
+ *			again only when its text changes
+ *
+ *	log() (sdliv_log.h) formats into a fixed size LogRecord and hands it
+ *		to Log, whose writer thread drains a lock-free ring to stdout
+ *		log_debug() and log_error() set the level, SDLIV_LOG_LEVEL strips
+ *			the ones below it at compile time
+ *		each call site gets ten lines a second, the rest are counted and
+ *			never formatted
+ *
+ *	perf (sdliv_perf.h) keeps a latency histogram for each pipeline stage,
+ *		detect, open, decode, convert, create, upload, draw, present and
+ *		scan, and counts the bytes decoded and uploaded
+ *		a ScopedTimer at the top of a function times it, from any thread;
+ *			each thread fills histograms of its own, so timing takes no lock
+ *		dump() prints p50/p90/p99/max, the App does on exit and on SIGUSR1
+ *		SDLIV_TRACE=path records every timer and Span, on every thread,
+ *			into per-thread rings written to path as a Chrome trace on exit
+ *		-DSDLIV_NO_PERF compiles it all out
+ *		source/bench.cpp steps through a directory headless and reports
+ *			the totals as JSON, make bench CORPUS=dir runs it
  */
 
 
@@ -57,12 +178,32 @@ namespace sdliv
 		extern const char * font_path;
 		extern const int window_minimum_width;
 		extern const int window_minimum_height;
+		extern const int loader_thread_count; //0 picks from core count
+		extern const int prefetch_radius; //neighbours decoded ahead
+		extern const size_t cache_surface_budget; //bytes of decoded pixels
+		extern const size_t cache_texture_budget; //bytes of uploaded textures
+		extern const size_t texture_pool_budget; //bytes of idle pooled textures
+		extern const int page_step; //files skipped by PageUp/PageDown
+		extern const int scanner_thread_count; //threads for recursive scans
+		extern const int thumbnail_size; //longest side of a thumbnail
+		extern const int grid_cell_padding; //pixels around each thumbnail
+		extern const int grid_layer; //window layer of the grid's Elements
+		extern const int hud_layer; //window layer of the HUD's Elements
+		extern const int hud_margin; //pixels between the HUD and the window edge
+		extern const int glyph_atlas_size; //starting edge length of a GlyphAtlas texture
+		extern const int tile_size; //TiledElement texture edge length
+		extern const size_t tile_texture_budget; //bytes of tiles per TiledElement
+		extern const double zoom_step; //factor per key press or wheel notch
+		extern const double zoom_max; //screen pixels per image pixel
+		extern const double full_decode_threshold; //screen pixels per decoded pixel
+		extern const int scaled_versions; //resampled copies kept per Element
 		//extern const int window_update_delay_ms;
 	}
 
 	typedef enum
 	{
 		FILETYPE_UNSUPPORTED,
+		FILETYPE_UNKNOWN, //not detected yet
 		FILETYPE_ICO,
 		FILETYPE_CUR,
 		FILETYPE_BMP,
@@ -81,10 +222,31 @@ namespace sdliv
 		FILETYPE_WEBP
 	} ImageFileType;
 
+	typedef enum
+	{
+		SORT_NAME, //natural order, IMG_9 before IMG_10
+		SORT_MTIME, //oldest first
+		SORT_SIZE, //smallest first
+		SORT_EXTENSION, //by extension, then by name
+		SORT_COUNT
+	} SortOrder;
+
 	class App;
 	class Window;
+	class TexturePool;
 	class Element;
+	class TiledElement;
+	class GlyphAtlas;
 	class Font;
+	class TextElement;
+	class Decoder;
+	class Loader;
+	class ImageCache;
+	class DirectoryWatcher;
+	class DirectoryScanner;
+	class ThumbnailStore;
+	class GridView;
+	class Hud;
 	class FileHandler;
 
 
@@ -103,6 +265,30 @@ namespace sdliv
 			// font rendering object for drawing filenames
 			Font * font;
 
+			// thumbnail sheet, drawn instead of active_element when shown
+			GridView * grid;
+
+			// performance overlay, drawn over everything when shown
+			Hud * hud;
+
+			// how active_element is shown, fit to the window or zoomed in
+			// with the image point (view_x, view_y) at the window centre
+			bool view_fit;
+			double view_zoom;
+			double view_x;
+			double view_y;
+			bool dragging;
+			FileHandler * viewed_file; //reset to fit when this changes, never dereferenced
+
+			//zoom by factor keeping the image point under (x, y) in place
+			int zoomAt(double factor, int x, int y);
+
+			//1:1 around the window centre, or back to fit
+			int toggleActualSize();
+
+			//move the view by a drag of dx, dy window pixels
+			int panBy(int dx, int dy);
+
 		public:
 
 			//sets pointers to nullptr
@@ -166,6 +352,9 @@ namespace sdliv
 			//elements is a map of all elements associated to the window
 			std::map<int, Element*> elements;
 
+			//recycled textures for the elements, outlives them all
+			TexturePool * texture_pool;
+
 		public:
 			//initializer should open a new SDL_Window
 			Window();
@@ -181,18 +370,47 @@ namespace sdliv
 			int getHeight() const;
 
 			SDL_Window* getWindow() const;
+			TexturePool * getTexturePool();
+
+			//the first 32 bit format with alpha the renderer lists that the
+			//Decoder can produce, pooled textures and decoded surfaces use it
+			Uint32 getNativeFormat() const;
 
 			// **FIXME** make sure we obey usable display area
 			int setSize(int w, int h);
 
 			Element * createElement(int layer = 0);
+			TiledElement * createTiledElement(int layer = 0);
+
+			//text drawn from f's glyph atlas
+			TextElement * createTextElement(Font * f, int layer = 0);
+
+			//a TiledElement if s is bigger than the renderer's largest
+			//texture, an Element otherwise
+			Element * createElementFor(const SDL_Surface * s, int layer = 0);
+
+			//largest texture the renderer takes, 0 if it has no limit
+			int getMaxTextureWidth() const;
+			int getMaxTextureHeight() const;
 			int addElement(Element * e, int layer = 0);
 			int removeElement(Element * e);
 			int changeElementLayer(Element * e, int layer);
 
+			//after SDL_RENDER_DEVICE_RESET, every texture has to be made again
+			int restoreTextures();
+
+			//scale that fits all of e in the window
+			double getFitScale(const Element * e) const;
+
+			//fit e to the window, showing all of it
 			int resizeElement(Element * e);
 			int centerElement(Element * e);
 
+			//show e at zoom screen pixels per image pixel, centred on the
+			//image point center_x, center_y, which is clamped so the view
+			//stays on the image; src_rect is cropped to the visible part
+			int viewElement(Element * e, double zoom, double * center_x, double * center_y);
+
 			int updateAll();
 			int updateLayer(int layer);
 			int updateElement(Element * e);
@@ -211,13 +429,67 @@ namespace sdliv
 	};
 
 
+	class TexturePool
+	{
+		private:
+			typedef struct
+			{
+				SDL_Texture * texture;
+				int width;
+				int height;
+				Uint32 format;
+				size_t bytes;
+			} Idle;
+
+			SDL_Renderer * renderer;
+			Uint32 format;
+
+			//back is most recently released
+			std::list<Idle> idle;
+			size_t idle_bytes;
+
+			unsigned long reused;
+			unsigned long created;
+
+		public:
+			//Elements upload into format, the renderer's own ideally
+			TexturePool(SDL_Renderer * r, Uint32 format);
+
+			//copy constructor shouldn't really be used, log it!
+			TexturePool(const TexturePool & p);
+
+			//destroys the idle textures, not the ones handed out
+			~TexturePool();
+
+			//a streaming texture of w by h in format, recycled if one is idle
+			//contents are undefined until upload()
+			SDL_Texture * acquire(int w, int h, Uint32 format);
+
+			//give t back for reuse, non-streaming textures are destroyed
+			int release(SDL_Texture * t);
+
+			//copy s into t, which must be the same size and format
+			static int upload(SDL_Texture * t, const SDL_Surface * s);
+
+			//destroy every idle texture, after a device reset they're lost
+			int clear();
+
+			Uint32 getFormat() const;
+			size_t getIdleBytes() const;
+			unsigned long getReused() const;
+			unsigned long getCreated() const;
+			double getReuseRate() const;
+	};
+
+
+
 	class Element
 	{
 		private:
 			static int Element_ID_count;
 			static int GetNextElementID();
 
-		private:
+		protected:
 			bool hidden;
 			bool is_copy;
 			int ID;
@@ -225,39 +497,124 @@ namespace sdliv
 			int ypos;
 			int zpos;
 
+			//full size of the image, src_rect is in these pixels
 			int width;
 			int height;
 
+			//size of the surface and texture, less than width and height
+			//when the image was decoded at reduced resolution
+			int decoded_width;
+			int decoded_height;
+
 			double scale;
 			double scale_x;
 			double scale_y;
 
 			SDL_Rect src_rect; //rectangle to draw from in the texture
 			SDL_Rect dst_rect; //rectangle to draw to in the window
-			SDL_Surface * surface;
+			SDL_Surface * surface; //nullptr once released
 			SDL_Renderer * renderer;
 			SDL_Texture * texture;
 
+			//where texture came from and goes back to, if anywhere
+			TexturePool * texture_pool;
+			bool texture_pooled;
+
+			//the whole image resampled to one draw size, front is newest
+			typedef struct
+			{
+				int width;
+				int height;
+				SDL_Texture * texture;
+				bool pooled;
+				size_t bytes;
+			} Scaled;
+
+			std::list<Scaled> scaled;
+			size_t scaled_bytes;
+
+			//file the surface can be decoded from again, empty if none
+			std::string source_path;
+
+			//texture from surface, through the pool when there is one
+			int uploadSurface();
+
+			//texture from s, which may be replaced by a converted copy
+			SDL_Texture * textureFrom(SDL_Surface ** s, bool * pooled);
+
+			//destroy or pool texture
+			int freeTexture();
+
+			//lost is true after a device reset, the textures can't be pooled
+			int freeScaled(bool lost = false);
+
+			//the scaled copy to draw instead, if the whole image is drawn
+			//at the size of one
+			SDL_Texture * findScaled() const;
+
 		public:
 			Element();
 			Element(const Element & e);
 			virtual ~Element();
-			int close(); //destroy surface, texture, not renderer
+			virtual int close(); //destroy surface, texture, not renderer
 
 			int setRenderingContext(SDL_Renderer * r);
 			SDL_Renderer * getRenderingContext();
+			int setTexturePool(TexturePool * p);
 
-			int createFromSurface(SDL_Surface * s);
+			virtual int createFromSurface(SDL_Surface * s);
 			int createFromImage(const char * path);
 			int createFromImage(const std::string & path);
 			int createFromText(Font * font, const char * txt);
 			int createFromText(Font * font, const std::string & txt);
 
+			//decode path into a locked texture with no surface in between
+			//only JPEGs that fit one texture, returns -1 for the rest so
+			//the caller can fall back to createFromSurface()
+			int createFromDecoder(const std::string & path, int target_width = 0, int target_height = 0);
+
+			//set before createFromSurface() to let the surface go after upload
+			int setSource(const std::string & path);
+			const std::string & getSource() const;
+
+			//the pixels, decoded again from the source if they were released
+			//the element keeps ownership, returns nullptr if there's no way back
+			SDL_Surface * getSurface();
+
+			//take s, the whole image resampled to a size it gets drawn at
+			//the element owns s either way
+			int addScaled(SDL_Surface * s);
+			bool hasScaled(int w, int h) const;
+
+			//free the surface if it can be regenerated, -1 if it's kept
+			virtual int releaseSurface();
+
+			//recreate the texture after a renderer device reset
+			//streaming textures come back empty for their owner to refill
+			virtual int restoreTexture();
+
+			//empty streaming texture of w by h, for updateTexture()
+			int createStreaming(int w, int h, Uint32 format);
+
+			//overwrite the top left w by h of a streaming texture, the
+			//element then draws just that part
+			int updateTexture(const void * pixels, int pitch, int w, int h);
+
 			int getID() const;
 			int getWidth() const;
 			int getHeight() const;
+
+			//the image is really w by h, the texture is a reduced version
+			int setLogicalSize(int w, int h);
+			int getDecodedWidth() const;
+			int getDecodedHeight() const;
+			bool isReduced() const;
 			int getLayer() const;
 
+			//memory held by the surface and texture, 0 if not present
+			virtual size_t getSurfaceBytes() const;
+			virtual size_t getTextureBytes() const;
+
 			double getDrawScale() const;
 			int getDrawWidth() const;
 			int getDrawHeight() const;
@@ -271,10 +628,210 @@ namespace sdliv
 			int setDrawSize(int w, int h);
 			int setDrawScale(double s);
 
+			//part of the image that gets drawn, clamped to the image
+			int setSourceRect(const SDL_Rect & r);
+			SDL_Rect getSourceRect() const;
+
+			//where src_rect lands in the window
+			int setDrawRect(const SDL_Rect & r);
+
 			int show();
 			int hide();
 			virtual int update();
-			int draw();
+			virtual int draw();
+	};
+
+
+
+	class TiledElement : public Element
+	{
+		private:
+			typedef struct
+			{
+				int level;
+				int column;
+				int row;
+			} TileKey;
+
+			struct TileKeyLess
+			{
+				bool operator()(const TileKey & a, const TileKey & b) const
+				{
+					if (a.level != b.level) return a.level < b.level;
+					if (a.row != b.row) return a.row < b.row;
+					return a.column < b.column;
+				}
+			};
+
+			typedef struct
+			{
+				SDL_Texture * texture;
+				size_t bytes;
+				Uint64 last_drawn; //frame number, for eviction
+			} Tile;
+
+			//mips[0] is surface in the format it was decoded in, so an image
+			//that only fits SDL's surface limit at 3 bytes a pixel still
+			//loads; its rows are expanded to ARGB8888 a tile or a mip row
+			//at a time; mips[k] is ARGB8888 at 1/2^k size, made the first
+			//time something is drawn at that scale
+			std::vector<SDL_Surface*> mips;
+
+			std::map<TileKey, Tile, TileKeyLess> tiles;
+			int tile_edge; //constants::tile_size unless the renderer wants less
+			size_t tile_bytes;
+			Uint64 frame;
+
+			//level whose pixels best match the current draw scale
+			int chooseLevel() const;
+
+			//make mips[level] from the nearest finer level that exists
+			SDL_Surface * getLevel(int level);
+
+			//find or upload one tile
+			SDL_Texture * getTile(int level, int column, int row);
+
+			//destroy least recently drawn tiles, sparing this frame's
+			int evictTiles();
+
+			int freeAll();
+
+		public:
+			TiledElement();
+			TiledElement(const TiledElement & e);
+			virtual ~TiledElement();
+
+			virtual int close();
+
+			//takes ownership of s, uploads nothing until drawn
+			virtual int createFromSurface(SDL_Surface * s);
+
+			//tiles are cut from the surface, it always stays
+			virtual int releaseSurface();
+
+			//drop every tile, draw() uploads the visible ones again
+			virtual int restoreTexture();
+
+			virtual size_t getSurfaceBytes() const;
+			virtual size_t getTextureBytes() const;
+
+			//draw the tiles under src_rect into dst_rect
+			virtual int draw();
+
+			int getTileCount() const;
+	};
+
+
+
+	class GlyphAtlas
+	{
+		public:
+			//src in the atlas, dst relative to the start of the text
+			typedef struct
+			{
+				SDL_Rect src;
+				SDL_Rect dst;
+			} Quad;
+
+		private:
+			typedef struct
+			{
+				SDL_Rect rect; //empty for glyphs with nothing to draw
+				int advance;
+			} Glyph;
+
+			SDL_Renderer * renderer;
+			TTF_Font * font;
+			SDL_Color color;
+			int line_height;
+
+			//a copy of the texture's pixels, to grow it and to bring it
+			//back after the renderer loses it
+			SDL_Surface * pixels;
+			SDL_Texture * texture;
+
+			//glyphs are packed left to right in rows of the tallest one
+			int pen_x;
+			int pen_y;
+			int row_height;
+
+			std::unordered_map<Uint32, Glyph> glyphs;
+
+			//rasterises the glyph the first time it's asked for
+			const Glyph * getGlyph(Uint32 codepoint);
+
+			//double the height, keeping every glyph where it is
+			int grow();
+
+		public:
+			GlyphAtlas(SDL_Renderer * r, TTF_Font * f, SDL_Color c);
+
+			//copy constructor shouldn't really be used, log it!
+			GlyphAtlas(const GlyphAtlas & a);
+
+			~GlyphAtlas();
+
+			//may change when the atlas grows, ask for it when drawing
+			SDL_Texture * getTexture() const;
+			int getWidth() const;
+			int getHeight() const;
+			int getLineHeight() const;
+
+			//UTF-8 text to quads, appended to quads; w and h get its size
+			int layout(const char * text, std::vector<Quad> * quads, int * w, int * h);
+
+			//after SDL_RENDER_DEVICE_RESET
+			int restoreTexture();
+
+			size_t getTextureBytes() const;
+	};
+
+
+
+	class TextElement : public Element
+	{
+		private:
+			Font * font;
+			GlyphAtlas * atlas; //the font's, in its colour at setText()
+			std::string text;
+
+			//glyph quads from the atlas, laid out from (0, 0)
+			std::vector<GlyphAtlas::Quad> quads;
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+			//the quads placed in dst_rect as geometry, again only when
+			//the element moves or the atlas grows
+			std::vector<SDL_Vertex> vertices;
+			std::vector<int> indices;
+			SDL_Rect placed_rect;
+			int placed_atlas_height;
+
+			int placeVertices();
+#endif
+
+		public:
+			TextElement();
+			TextElement(const TextElement & e);
+			virtual ~TextElement();
+
+			virtual int close();
+
+			int setFont(Font * f);
+
+			//lays text out again only if it changed, nothing is rasterised
+			//unless a glyph is new to the atlas
+			int setText(const std::string & t);
+			const std::string & getText() const;
+
+			//the atlas is the Font's, there's nothing of the element's own
+			virtual int releaseSurface();
+			virtual int restoreTexture();
+			virtual size_t getSurfaceBytes() const;
+			virtual size_t getTextureBytes() const;
+
+			//every glyph in one SDL_RenderGeometry() call, a copy per glyph
+			//before SDL 2.0.18
+			virtual int draw();
 	};
 
 
@@ -295,6 +852,9 @@ namespace sdliv
 			static Font * openFont(Window * window, const char * path, int font_size = 12);
 			static Font * openFont(Window * window, const std::string & path, int font_size = 12);
 
+			//every open font's atlases, after SDL_RENDER_DEVICE_RESET
+			static int restoreTextures();
+
 		private:
 			int ID;
 			int font_height;
@@ -303,6 +863,9 @@ namespace sdliv
 			SDL_Renderer * renderer;
 			SDL_Color c;
 
+			//one glyph atlas per colour text has been drawn in, keyed by RGBA
+			std::map<Uint32, GlyphAtlas*> atlases;
+
 
 		public:
 			Font();
@@ -319,6 +882,656 @@ namespace sdliv
 
 			SDL_Surface * renderText(const char * txt);
 			SDL_Surface * renderText(const std::string & txt);
+
+			//the atlas for the current colour, made on first use
+			GlyphAtlas * getAtlas();
+	};
+
+
+
+	class Decoder
+	{
+		private:
+			static SDL_Surface * decodeJPEG(FILE * f, int target_width, int target_height, Uint32 format,
+					int * full_width, int * full_height);
+
+			//box filter s down by reduction, rounding the size up, frees s
+			static SDL_Surface * shrink(SDL_Surface * s, int reduction);
+
+		public:
+			//called once the output size is known, returns where row 0
+			//goes and sets pitch, or nullptr to give up
+			typedef std::function<void*(int width, int height, int * pitch)> RowSink;
+
+			//largest power of two the image can be divided by and still
+			//be at least as big as when fitted to target
+			static int reductionFor(int width, int height, int target_width, int target_height);
+
+			//true if decodeInto() can write format
+			static bool canDecodeInto(Uint32 format);
+
+			//SDL refuses surfaces of 2^31 bytes or more, rows padded to 4
+			static bool fitsSurface(int width, int height, int bytes_per_pixel);
+
+			//decode path small enough to fit target_width by target_height,
+			//full size if either is 0; full_width and full_height get the
+			//size of the image before any reduction
+			//the surface is in format unless that's SDL_PIXELFORMAT_UNKNOWN
+			static SDL_Surface * decode(const std::string & path, int target_width, int target_height,
+					int * full_width, int * full_height, Uint32 format = SDL_PIXELFORMAT_UNKNOWN);
+
+			//s area resampled to exactly width by height, for shrinking
+			//frees s unless it's returned, as it is if it's no bigger
+			//rows are split into bands across cores
+			static SDL_Surface * resample(SDL_Surface * s, int width, int height);
+
+			//a copy of s, decoded from a full_width by full_height image,
+			//area resampled to the size Window::resizeElement() draws that
+			//image at in a box_width by box_height window; nullptr if that
+			//isn't smaller than s or s isn't 32 bit
+			static SDL_Surface * resampleToFit(const SDL_Surface * s, int full_width, int full_height,
+					int box_width, int box_height);
+
+			//s in format, frees s unless it's returned, which it is if it
+			//was already in format, couldn't be converted or would be too
+			//big a surface in format
+			//24 bit RGB to 32 bit goes through util's SIMD kernels
+			static SDL_Surface * convert(SDL_Surface * s, Uint32 format);
+
+			//decode a JPEG in format straight into the memory sink hands
+			//back, reduced by at most 1/8 towards target
+			//returns -1 for anything else, a failure after sink was called
+			//leaves its memory partly written
+			static int decodeInto(const std::string & path, int target_width, int target_height,
+					Uint32 format, const RowSink & sink, int * full_width, int * full_height);
+	};
+
+
+
+	class Loader
+	{
+		public:
+			typedef struct
+			{
+				SDL_Surface * surface; //nullptr if decoding failed
+				int full_width; //size before any reduction
+				int full_height;
+				bool exact; //resampled to the requested size for display
+
+				//surface resampled to how it's drawn fitted to the job's
+				//fit box, nullptr if that's no smaller than surface
+				SDL_Surface * fitted;
+			} Result;
+
+		private:
+			typedef struct
+			{
+				int id;
+				std::string path;
+				int target_width; //0 for full resolution
+				int target_height;
+				bool exact; //resample to exactly the target size
+				int fit_width; //box to make a fitted copy for, 0 for none
+				int fit_height;
+			} Job;
+
+			static bool module_initialized;
+			static bool stopping;
+			static Uint32 event_type;
+
+			//workers convert to this so uploads are a plain copy
+			//set before the workers start, read only after
+			static Uint32 surface_format;
+
+			static std::vector<std::thread> workers;
+
+			//jobs waiting for a worker, front is decoded first
+			static std::deque<Job> jobs;
+
+			//ids that are queued, decoding, or waiting in the event queue,
+			//with whether the job is exact; one of each kind per id
+			static std::set<std::pair<int, bool>> pending;
+
+			static std::mutex jobs_mutex;
+			static std::condition_variable jobs_cv;
+
+			//worker thread body
+			static void work();
+
+		public:
+			//starts the worker threads and registers the user event type
+			//decoded surfaces are delivered in format, as decoded if it's
+			//SDL_PIXELFORMAT_UNKNOWN
+			static int init(int thread_count = 0, Uint32 format = SDL_PIXELFORMAT_UNKNOWN);
+
+			//joins the workers and frees any undelivered surfaces
+			static int quit();
+
+			static bool isInit();
+
+			//events of this type carry a decoded image:
+			//	user.code is the id passed to request()
+			//	user.data1 is a heap Result* which the receiver must delete
+			static Uint32 getEventType();
+
+			//queue path for decoding, urgent jobs skip to the front
+			//a target size lets the Decoder skip detail that won't be seen
+			//exact jobs are area resampled to exactly the target size
+			//with a fit box, plain jobs also resample what they decoded to
+			//the size it's drawn fitted to the box, as Result::fitted
+			//returns 1 if a job of the same kind was already pending
+			static int request(int id, const std::string & path, bool urgent = false,
+					int target_width = 0, int target_height = 0, bool exact = false,
+					int fit_width = 0, int fit_height = 0);
+
+			//main thread calls this once it has consumed the result for id
+			static int finish(int id, bool exact = false);
+
+			//drop jobs that no worker has started yet
+			//ids of plain decodes are appended to cancelled_ids if it isn't
+			//nullptr, exact jobs are just dropped
+			static int cancelAll(std::vector<int> * cancelled_ids = nullptr);
+
+			static bool isPending(int id);
+			static int getQueueDepth();
+	};
+
+
+
+	class ImageCache
+	{
+		public:
+			typedef struct Key
+			{
+				std::string path;
+				std::filesystem::file_time_type mtime;
+				std::uintmax_t size;
+
+				bool operator<(const Key & k) const;
+				bool operator==(const Key & k) const;
+			} Key;
+
+		private:
+			typedef struct
+			{
+				Element * element;
+				Window * window;
+				size_t surface_bytes;
+				size_t texture_bytes;
+				std::list<Key>::iterator lru_position;
+			} Entry;
+
+			static std::map<Key, Entry> entries;
+
+			//front is most recently used
+			static std::list<Key> lru;
+
+			static size_t surface_budget;
+			static size_t texture_budget;
+			static size_t surface_bytes;
+			static size_t texture_bytes;
+
+			static unsigned long hits;
+			static unsigned long misses;
+
+			//never evicted, this is what the App is drawing
+			//if its entry is invalidated the element lives on, orphaned,
+			//until a different element is pinned
+			static Element * pinned;
+			static Window * pinned_window;
+			static bool pinned_orphaned;
+
+			static int erase(std::map<Key, Entry>::iterator iter);
+
+			//evict from the back of lru until within budget, sparing keep
+			static int evict(const Element * keep);
+
+		public:
+			//returns cached element and marks it used, counts a hit or miss
+			static Element * get(const Key & key);
+
+			//like get() without touching stats or lru order
+			static Element * peek(const Key & key);
+
+			//like get() without touching stats, for a lookup already counted
+			static Element * touch(const Key & key);
+			static bool contains(const Key & key);
+
+			//create an element in w from s and cache it under key
+			//the cache takes ownership of s
+			static Element * insert(Window * w, const Key & key, SDL_Surface * s);
+
+			//cache an element already created in w, the cache owns it now
+			static Element * adopt(Window * w, const Key & key, Element * e);
+
+			//drop one entry, or every entry for a path
+			static int invalidate(const Key & key);
+			static int invalidate(const std::string & path);
+
+			//removes every element from its window and deletes it
+			static int clear();
+
+			static int pin(Element * e);
+
+			static int setBudget(size_t surface_budget_bytes, size_t texture_budget_bytes);
+
+			//ask every element what it holds again, after surfaces were
+			//regenerated or textures restored
+			static int recount();
+
+			static size_t getSurfaceBytes();
+			static size_t getTextureBytes();
+			static unsigned long getHits();
+			static unsigned long getMisses();
+			static double getHitRate();
+	};
+
+
+
+	class DirectoryWatcher
+	{
+		public:
+			typedef enum
+			{
+				WATCH_ADDED, //a file was moved into the directory
+				WATCH_REMOVED, //a file was deleted or moved out
+				WATCH_MODIFIED, //a file was closed after writing, may be new
+				WATCH_RESCAN //events were lost, rescan the whole directory
+			} Change;
+
+		private:
+			static bool module_initialized;
+			static Uint32 event_type;
+
+			static int inotify_fd;
+			static int watch_descriptor;
+
+			//written to by quit() to wake the thread out of poll()
+			static int wake_pipe[2];
+
+			static std::thread watcher;
+			static std::filesystem::path watched_directory;
+
+			//the kernel dropped the watch (directory deleted or moved), the
+			//next watch() sets it up again even for the same path
+			static std::atomic<bool> watch_lost;
+
+			//watcher thread body
+			static void work();
+
+			//push a change for path (may be empty for WATCH_RESCAN)
+			static int post(Change change, const std::string & path);
+
+		public:
+			//registers the user event type, returns -1 if inotify is unavailable
+			static int init();
+
+			//stops watching and frees undelivered events
+			static int quit();
+
+			//start watching dir, replacing any previous directory or a
+			//watch the kernel dropped
+			static int watch(const std::filesystem::path & dir);
+
+			//stop the watcher thread, init() state is kept
+			static int stop();
+
+			static bool isInit();
+			static bool isWatching();
+
+			//events of this type describe one change:
+			//	user.code is a Change
+			//	user.data1 is a heap std::string* with the full path, which
+			//		the receiver must delete
+			static Uint32 getEventType();
+	};
+
+
+
+	class DirectoryScanner
+	{
+		public:
+			typedef struct
+			{
+				int generation; //which scan() this came from
+				bool last; //no more batches follow for this generation
+				std::vector<std::filesystem::directory_entry> entries;
+			} Batch;
+
+		private:
+			typedef struct
+			{
+				std::filesystem::path path;
+				int depth; //0 is the directory passed to scan()
+				size_t subtree; //index into subtree_names
+			} Directory;
+
+			static bool module_initialized;
+			static Uint32 event_type;
+
+			static std::thread scanner;
+			static std::atomic<bool> cancelled;
+			static std::atomic<bool> scanning;
+			static std::atomic<int> generation;
+
+			//directory entries looked at, and those that passed the filter
+			static std::atomic<size_t> scanned_count;
+			static std::atomic<size_t> matched_count;
+
+			//settings for the running scan, fixed while it runs
+			static std::set<std::string> extensions;
+			static bool recursive;
+			static int max_depth;
+
+			//directories waiting to be listed, used as a stack so it only
+			//grows with the depth and width of the tree, not its size
+			static std::vector<Directory> directories;
+			static int busy_workers;
+			static std::mutex directories_mutex;
+			static std::condition_variable directories_cv;
+
+			//directories already listed, by device and inode, so symlinks
+			//can't send a recursive scan round in circles
+			static std::set<std::pair<Uint64, Uint64>> visited;
+
+			//files found under each top level subdirectory, "." for the root
+			static std::vector<std::string> subtree_names;
+			static std::vector<size_t> subtree_counts;
+			static std::mutex progress_mutex;
+
+			//scanner thread body, runs one worker itself and joins the rest
+			static void work(int gen);
+
+			//lists directories from the stack until there are none left
+			static void listDirectories(int gen);
+
+			//list one directory, files go into batch and subdirectories
+			//onto the stack, batch is posted and replaced when it fills up
+			static int listDirectory(const Directory & d, Batch *& batch, size_t & batch_size);
+
+			//false if the directory has been listed already
+			static bool markVisited(const std::filesystem::path & dir);
+
+			static int post(Batch * batch);
+
+		public:
+			//registers the user event type
+			static int init();
+
+			//cancels any scan and frees undelivered batches
+			static int quit();
+
+			static bool isInit();
+
+			//list regular files in dir whose extension is in extensions,
+			//replacing any scan already running
+			//a recursive scan descends at most max_depth levels, -1 for no limit
+			static int scan(const std::filesystem::path & dir, const std::set<std::string> & extensions,
+					bool recursive = false, int max_depth = -1);
+
+			//stop the scan thread, batches already posted are still delivered
+			static int cancel();
+
+			static bool isScanning();
+			static int getGeneration();
+			static size_t getScannedCount();
+			static size_t getMatchedCount();
+
+			//files found so far under each top level subdirectory
+			static std::vector<std::pair<std::string, size_t>> getSubtreeProgress();
+
+			//events of this type carry one batch:
+			//	user.data1 is a heap Batch* which the receiver must delete
+			static Uint32 getEventType();
+	};
+
+
+
+	class ThumbnailStore
+	{
+		public:
+			typedef struct
+			{
+				const Uint32 * pixels; //ARGB8888, points into the mapped container
+				int width;
+				int height;
+				int pitch;
+			} Thumbnail;
+
+		private:
+			//on disk layout, native byte order, the cache is per machine
+			//pixels follow the header and the index comes last; a flush
+			//appends pixels and a new index, then points the header at it
+			typedef struct
+			{
+				char magic[8];
+				Uint32 version;
+				Uint32 count; //entries in the index
+				Uint32 thumbnail_size;
+				Uint32 reserved;
+				Uint64 index_offset; //from the start of the file, 8 byte aligned
+			} Header;
+
+			typedef struct
+			{
+				Uint64 path_hash; //index is sorted on this
+				Sint64 mtime; //file_time_type ticks
+				Uint64 size;
+				Uint64 offset; //of the pixels from the start of the file
+				Uint32 width;
+				Uint32 height;
+			} IndexEntry;
+
+			//count and index are read once when mapped, a flush appending
+			//to the file rewrites the header under an existing mapping
+			typedef struct
+			{
+				void * data;
+				size_t length;
+				const Header * header;
+				const IndexEntry * index;
+				Uint32 count;
+			} Container;
+
+			typedef struct
+			{
+				IndexEntry entry;
+				SDL_Surface * surface;
+			} Generated;
+
+			typedef struct
+			{
+				std::filesystem::path dir;
+				std::vector<std::string> paths;
+			} Job;
+
+			static bool module_initialized;
+			static Uint32 event_type;
+
+			//container for the directory the main thread is looking at
+			static Container mapped;
+			static std::filesystem::path mapped_directory;
+
+			static std::thread generator;
+			static bool stopping;
+			static bool working; //the thread has a job in hand, under jobs_mutex
+			static std::atomic<bool> interrupted;
+			static std::deque<Job> jobs;
+			static std::mutex jobs_mutex;
+			static std::condition_variable jobs_cv;
+
+			static std::filesystem::path cacheDirectory();
+			static std::filesystem::path containerPath(const std::filesystem::path & dir);
+			static Uint64 hashPath(const std::string & path);
+
+			//map a container read only, an empty container if there is none
+			static int mapContainer(const std::filesystem::path & file, Container * c);
+			static void unmapContainer(Container * c);
+			static const IndexEntry * findEntry(const Container & c, Uint64 path_hash);
+
+			//generator thread body
+			static void work();
+
+			//decode path and shrink it to fit thumbnail_size
+			static SDL_Surface * generate(const std::string & path);
+
+			//merge generated thumbnails into dir's container, appending to it
+			//unless most of it is replaced thumbnails and old indexes
+			static int flush(const std::filesystem::path & dir, std::vector<Generated> & generated);
+
+			static int post(const std::filesystem::path & dir);
+
+		public:
+			//registers the user event type and starts the generator thread
+			static int init();
+
+			//stops the generator, unmaps and frees undelivered events
+			static int quit();
+
+			static bool isInit();
+
+			//map the container for dir, replacing any mapped one
+			static int open(const std::filesystem::path & dir);
+
+			//map the container for the open directory again
+			static int reload();
+
+			static int close();
+
+			//finds a thumbnail for path that is still valid for mtime and size,
+			//valid until the next open(), reload() or close()
+			static bool lookup(const std::string & path, std::filesystem::file_time_type mtime,
+					uintmax_t size, Thumbnail * thumbnail);
+
+			//generate thumbnails for paths in dir that don't have one,
+			//replacing any request still queued
+			static int request(const std::filesystem::path & dir, const std::vector<std::string> & paths);
+
+			//thumbnails in the mapped container
+			static size_t getCount();
+
+			//events of this type mean a container was written to:
+			//	user.data1 is a heap std::string* with the directory, which
+			//		the receiver must delete
+			static Uint32 getEventType();
+	};
+
+
+
+	class GridView
+	{
+		private:
+			Window * window;
+			bool shown;
+
+			//cell i of the sheet uses slot i % pool.size(), the pool covers
+			//every cell that can be on screen at once so they never collide
+			std::vector<Element*> pool;
+			std::vector<size_t> slot_index; //file index held, npos if none
+			std::vector<bool> slot_loaded; //false while it has no thumbnail
+
+			size_t selected;
+			long scroll; //pixels from the top of the sheet to the window top
+
+			static const size_t npos = (size_t) -1;
+
+			int getCellSize() const;
+			int getColumns() const;
+			int getVisibleRows() const;
+
+			//match the pool to the window size, forgets every slot if it changes
+			int resizePool();
+
+			//upload the thumbnail for file index into slot
+			int loadSlot(size_t slot, size_t index);
+
+			//keep scroll within the sheet and the selection on screen
+			int clampScroll();
+			int scrollToSelected();
+
+		public:
+			GridView(Window * w);
+
+			//copy constructor shouldn't really be used, log it!
+			GridView(const GridView & g);
+
+			//removes the pool from the window and deletes it
+			~GridView();
+
+			int show();
+			int hide();
+			bool isShown() const;
+
+			//tracked_files changed, reload every visible cell
+			int invalidate();
+
+			//new thumbnails were stored, retry cells still without one
+			int refreshMissing();
+
+			int select(size_t index);
+			size_t getSelected() const;
+
+			int scrollBy(long pixels);
+
+			//arrows, PageUp/PageDown, Home and End move the selection
+			//returns false for keys it doesn't use
+			bool onKey(SDL_Keycode key);
+
+			//draw the visible cells, the caller clears and presents
+			int draw();
+	};
+
+
+
+	class Hud
+	{
+		private:
+			typedef enum
+			{
+				FIELD_FRAME,
+				FIELD_DECODE,
+				FIELD_UPLOAD,
+				FIELD_CACHE,
+				FIELD_QUEUE,
+				FIELD_MEMORY,
+				FIELD_FILE,
+				FIELD_COUNT
+			} Field;
+
+			Window * window;
+			Font * font;
+			bool shown;
+
+			//one TextElement per field in the window's hud_layer, laid out
+			//again only when its text changes
+			std::vector<TextElement*> lines;
+
+			std::uint64_t frame_ns;
+
+			int setField(Field field, const std::string & text);
+
+			//every field's text from the current numbers
+			int refresh();
+
+		public:
+			Hud(Window * w, Font * f);
+
+			//copy constructor shouldn't really be used, log it!
+			Hud(const Hud & h);
+
+			//removes the lines from the window and deletes them
+			~Hud();
+
+			int show();
+			int hide();
+			int toggle();
+			bool isShown() const;
+
+			//how long the last frame took, shown in the next one
+			int setFrameTime(std::uint64_t ns);
+
+			//draw over whatever is on screen, the caller clears and presents
+			int draw();
 	};
 
 
@@ -332,12 +1545,30 @@ namespace sdliv
 	class FileHandler
 	{
 		private:
-			//master list of all FileHandler instances sorted by filename
+			//master list of all FileHandler instances sorted by sort_order
+			//contiguous so navigation by position is O(1)
+			//setComparison only reads keys precomputed in each FileHandler
+			static SortOrder sort_order;
 			static bool setComparison(const FileHandler *, const FileHandler *);
-			static std::set<FileHandler *, decltype(setComparison)*> tracked_files;
+			static std::vector<FileHandler *> tracked_files;
+
+			//tracked files by path below the working directory, the views
+			//point into each relative_path
+			typedef std::string_view PathView;
+			static std::unordered_map<PathView, FileHandler *> tracked_paths;
+
+			//p as it's kept in relative_path: below the working directory
+			//if it's there, absolute if not
+			static std::string relativePath(const std::filesystem::path & p);
 
 			//the active image file that we're viewing in our app
+			//and its position in tracked_files, kept in step by track()/untrack()
 			static FileHandler * active_image;
+			static size_t active_index;
+
+			//activate() already counted this file's cache lookup, the one
+			//update() makes once its decode lands isn't a second
+			static const FileHandler * lookup_counted;
 
 			//image extensions we support
 			static std::set<std::string> supportedExtensions;
@@ -346,21 +1577,92 @@ namespace sdliv
 			//start tracking fh in tracked_files
 			static int track(FileHandler * fh);
 
-			//stop tracking fh in tracked files
-			static std::set<FileHandler*>::iterator untrack(std::set<sdliv::FileHandler*>::iterator fhIter);
+			//stop tracking and delete the file at index
+			//returns index, which now holds the file that followed it
+			//if it was the active image, active_image becomes nullptr
+			static size_t untrack(size_t index);
+
+			//move the file at index to where its keys now sort
+			static int reposition(size_t index);
+
+			//track many files at once with one sort and one merge
+			static int trackBatch(std::vector<FileHandler*> & batch);
+
+			//position of fh in tracked_files by binary search, npos if untracked
+			static const size_t npos = (size_t) -1;
+			static size_t indexOf(const FileHandler * fh);
+
+			//filename and position in the window title
+			static void updateTitle();
 
 			//folder we're looking at for images
 			static std::filesystem::directory_entry workingDirectory;
 
+			//FileHandlers with a Loader job outstanding, by ID, so results can
+			//find their file; only these, to keep per-file memory down
+			static int ID_count;
+			static std::map<int, FileHandler*> handlers;
+
+			//register fh in handlers and queue it on the Loader, at window
+			//size unless full is set or reduced decoding is off
+			static int requestDecode(FileHandler * fh, bool urgent, bool full = false);
+
+			//hand a resampled copy to the active image's element if id is
+			//still the active file, frees s otherwise
+			static bool receiveScaled(int id, SDL_Surface * s);
+
+			//decode at window size rather than full resolution
+			static bool reduced_decode;
+
+			//how many files either side of active_image get decoded ahead
+			static int prefetch_radius;
+
+			//queue the active image and its neighbours on the Loader
+			static int prefetch();
+
+			//make active_image current, decoding it synchronously unless
+			//async is set and the Loader can do it in the background
+			static Element * activate(bool async);
+
+			//openDirectory() defers type detection to update()
+			static bool lazy_detection;
+
+			//openDirectory() descends into subdirectories
+			static bool recursive_scan;
+			static int recursive_max_depth;
+
+			//tracked FileHandler with this path, nullptr if none
+			static FileHandler * findTracked(const std::filesystem::path & path);
+
+			//ask the ThumbnailStore for every tracked file's thumbnail
+			static int requestThumbnails();
+
+			//a scan to recover from lost watcher events is under way, when it
+			//ends untrackUnlisted() drops every file it didn't find
+			static bool rescanning;
+			static int rescanDirectory();
+			static int untrackUnlisted();
+
 		public:
 			//return nullptr if unsupported file type
+			//with detect false only the extension is checked, the file
+			//isn't touched and is dropped later if it isn't an image
 			static FileHandler* openFileIfSupported(const char * filepath);
 			static FileHandler* openFileIfSupported(const std::string & filepath);
-			static FileHandler* openFileIfSupported(const std::filesystem::directory_entry & file);
+			static FileHandler* openFileIfSupported(const std::filesystem::directory_entry & file, bool detect = true);
 
 			//begin tracking all files in a directory
+			//the scan runs on the DirectoryScanner when it's available,
+			//in which case this returns 0 and files arrive as events
 			static int openDirectory(bool force = true);
 
+			//on by default, so scanning a directory is only a readdir pass
+			static void setLazyDetection(bool lazy);
+
+			//include subdirectories, at most max_depth levels down (-1 no limit)
+			//takes effect on the next openDirectory()
+			static void setRecursive(bool recursive, int max_depth = -1);
+
 			//get the Element object for the current active image file
 			static Element * getActiveImage();
 
@@ -370,41 +1672,126 @@ namespace sdliv
 			//backup to the previous tracked image file
 			static Element * prevImage();
 
+			//make the file at index active, clamped to the last file
+			static Element * jumpToIndex(size_t index);
+
+			//move delta files forward or back, clamped at either end
+			static Element * stepImage(long delta);
+
+			static Element * firstImage();
+			static Element * lastImage();
+
+			//0.0 is the first file, 1.0 the last
+			static Element * jumpToFraction(double fraction);
+
+			static size_t getActiveIndex();
+			static size_t getTrackedCount();
+
+			//file at index in the current sort order, nullptr past the end
+			static FileHandler * getTrackedFile(size_t index);
+
+			//re-sort tracked_files, the active image keeps its place on screen
+			static int setSortOrder(SortOrder order);
+			static SortOrder getSortOrder();
+
+			//take ownership of a surface delivered by the Loader
+			//returns true if it belongs to the active image
+			static bool onImageDecoded(SDL_Event * e);
+
+			//the active image is shown past what its reduced decode holds,
+			//queue a full resolution one; 0 if there's nothing to do
+			static int requestFullResolution();
+
+			//the active image is fitted at width by height and shrunk,
+			//queue a copy resampled to exactly that for it to draw instead
+			static int requestScaled(int width, int height);
+
+			//on by default
+			static void setReducedDecode(bool reduced);
+
+			//identifies the active file, nullptr if none
+			static FileHandler * getActiveFile();
+
+			//apply one change reported by the DirectoryWatcher
+			//returns true if the active image needs to be fetched again
+			static bool onDirectoryChanged(SDL_Event * e);
+
+			//merge one batch from the DirectoryScanner into tracked_files
+			//returns true if there was no active image and now there is
+			static bool onDirectoryScanned(SDL_Event * e);
+
+			//remap the thumbnail container if it's for the working directory
+			//returns true if it was
+			static bool onThumbnailsStored(SDL_Event * e);
+
+			static int setPrefetchRadius(int radius);
+
 			static int untrackAll();
 
 			std::string getPathAsString() const;
 
 			static void addSupport(const std::string &extension);
 
+			//tracked files are stored relative to it and moved along
 			static std::filesystem::directory_entry getWorkingDirectory();
 			static int setWorkingDirectory(std::filesystem::path);
 			static int setWorkingDirectory(std::string);
 
 
 		private:
+			int ID;
 			ImageFileType type;
 
 			SDL_RWops * rwops;
 			Window * window;
-			Element * element;
 
-			std::filesystem::directory_entry fs_entry;
+			//all a tracked file keeps of its path, relative to workingDirectory
+			//unless it's outside it; the sort keys are read from it in place
+			std::string relative_path;
+
+			//what the name and extension orders compare, views into relative_path
+			std::string_view sortName() const;
+			std::string_view sortExtension() const;
+
+			//the rescan under way found this file, or it was tracked since
+			bool listed;
+
+			//stat results the cache key was built from, see refreshKey()
+			//also the sort keys for SORT_MTIME and SORT_SIZE
+			bool key_valid;
+			std::filesystem::file_time_type mtime;
+			std::uintmax_t file_size;
 
 			//create rwops or return error
 			int open();
 			//create element from existing rwops or return error
 			int read();
+			//JPEGs skip rwops and the surface, decoding into a texture
+			int readDirect();
 			//destroy rwops or return error if already null
 			int close();
+			//hand s to the ImageCache under this file's key
+			//full_width and full_height are the image's size if s is reduced
+			int receive(SDL_Surface * s, int full_width = 0, int full_height = 0);
+
+			//stat the file for mtime and size, returns -1 if that fails
+			int refreshKey();
+			ImageCache::Key getCacheKey() const;
+
+			//the cached element for the current key, nullptr if not cached
+			Element * getElement() const;
 
 		public:
+			//the stored thumbnail if there is one for the current key
+			bool getThumbnail(ThumbnailStore::Thumbnail * thumbnail);
+
 			//null and zero values
 			FileHandler();
 
 			//calls setTarget(filename)
 			FileHandler(const char * filename);
 			FileHandler(const std::string & filename);
-			FileHandler(const std::filesystem::directory_entry & file);
+			FileHandler(const std::filesystem::directory_entry & file, bool detect = true);
 
 			//we should log this because these wont like being copied bitwise
 			FileHandler(const FileHandler & fh);
@@ -413,18 +1800,27 @@ namespace sdliv
 			~FileHandler();
 
 			std::filesystem::path parent_path() const;
+
+			//the full path, workingDirectory joined with relative_path
+			std::filesystem::path getPath() const;
 			//read image data if file has been updated or if it hasn't been read
+			//detects the type first if that was deferred
 			int update();
 
-			//fills fs_entry
-			//infers type from filename
+			//fills relative_path
+			//infers type from file contents unless detect is false
 			int setTarget(const char *filename);
 			int setTarget(const std::string & filename);
-			int setTarget(const std::filesystem::directory_entry & file);
+			int setTarget(const std::filesystem::directory_entry & file, bool detect = true);
 
-			//opens file briefly and uses IMG_isX() to discover image type
+			//reads the first few bytes of the file and matches them against
+			//known signatures, falls back to IMG_isSVG() for SVG
 			ImageFileType detectImageType();
 
+			//classify a file header, FILETYPE_UNSUPPORTED if nothing matched
+			static const size_t sniff_length = 16;
+			static ImageFileType sniffImageType(const unsigned char * header, size_t length);
+
 
 	};
 
@@ -3,43 +3,172 @@
 
 //template functions need to be fully declared within header file
 
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <string>
+#include <typeinfo>
 
-// Expand call to include filename and line number
-#define log(...) _log(__FILE__, __LINE__, __VA_ARGS__)
+// levels, calls below SDLIV_LOG_LEVEL compile to nothing, arguments and all
+#define SDLIV_LOG_DEBUG 0
+#define SDLIV_LOG_INFO 1
+#define SDLIV_LOG_ERROR 2
+
+#ifndef SDLIV_LOG_LEVEL
+#define SDLIV_LOG_LEVEL SDLIV_LOG_INFO
+#endif
+
+// each call site gets its own rate limit, checked before anything is formatted
+#define SDLIV_LOG_AT(level, ...) \
+	do { \
+		static ::sdliv::LogSite _sdliv_log_site; \
+		if (_sdliv_log_site.admit()) ::sdliv::_log(level, __FILE__, __LINE__, _sdliv_log_site, __VA_ARGS__); \
+	} while (0)
+
+#if SDLIV_LOG_LEVEL <= SDLIV_LOG_DEBUG
+#define log_debug(...) SDLIV_LOG_AT(SDLIV_LOG_DEBUG, __VA_ARGS__)
+#else
+#define log_debug(...) do {} while (0)
+#endif
+
+#if SDLIV_LOG_LEVEL <= SDLIV_LOG_INFO
+#define log(...) SDLIV_LOG_AT(SDLIV_LOG_INFO, __VA_ARGS__)
+#else
+#define log(...) do {} while (0)
+#endif
+
+#define log_error(...) SDLIV_LOG_AT(SDLIV_LOG_ERROR, __VA_ARGS__)
 
 namespace sdliv {
+	// one formatted line, fixed size so logging never touches the heap
+	struct LogRecord
+	{
+		static const size_t capacity = 256;
+
+		int level;
+		size_t length;
+		char text[capacity];
+
+		void append(const char * s, size_t n)
+		{
+			n = (length + n < capacity - 1) ? n : capacity - 1 - length;
+			memcpy(text + length, s, n);
+			length += n;
+			text[length] = '\0';
+		}
+
+		void append(const char * s) { append(s, strlen(s)); }
+	};
+
+	// a burst of messages per second from one call site, the rest are
+	// counted and mentioned in the next one that gets through
+	class LogSite
+	{
+		private:
+			static const int burst = 10;
+			static const ::std::int64_t window_ms = 1000;
+
+			::std::atomic<::std::int64_t> window_start;
+			::std::atomic<int> admitted;
+			::std::atomic<int> suppressed;
+
+		public:
+			constexpr LogSite() : window_start(0), admitted(0), suppressed(0) {}
+
+			bool admit()
+			{
+				::std::int64_t now = (::std::int64_t) ::std::chrono::duration_cast<::std::chrono::milliseconds>(
+						::std::chrono::steady_clock::now().time_since_epoch()).count();
+
+				::std::int64_t start = window_start.load(::std::memory_order_relaxed);
+				if (now - start >= window_ms && window_start.compare_exchange_strong(start, now, ::std::memory_order_relaxed))
+				{
+					admitted.store(0, ::std::memory_order_relaxed);
+				}
+
+				if (admitted.fetch_add(1, ::std::memory_order_relaxed) < burst) return true;
+
+				suppressed.fetch_add(1, ::std::memory_order_relaxed);
+				return false;
+			}
+
+			int takeSuppressed() { return suppressed.exchange(0, ::std::memory_order_relaxed); }
+	};
+
+	// lines go through a lock-free ring to a writer thread once init() has
+	// run, straight to stdout before that and after quit()
+	class Log
+	{
+		private:
+			static ::std::atomic<bool> running;
+
+		public:
+			static int init();
+			static int quit();
+			static bool isInit();
+
+			static void write(const LogRecord & record);
+	};
+
 	// privatize stringify(...) within this file
 	namespace {
 		// end of recursive variadic call
-		inline ::std::string stringify(void) { return ::std::string(); }
+		inline void stringify(LogRecord &) {}
 
 		// individual types that we know how to stringify
-		inline ::std::string stringify(::std::string v) { return v; }
-		inline ::std::string stringify(const char *c) { return ::std::string(c); }
-		inline ::std::string stringify(int v) { return ::std::to_string(v); }
-		inline ::std::string stringify(bool v) { return ::std::string(v ? "true" : "false"); }
+		inline void stringify(LogRecord & r, const ::std::string & v) { r.append(v.data(), v.size()); }
+		inline void stringify(LogRecord & r, const char *c) { r.append(c != nullptr ? c : "(null)"); }
+		inline void stringify(LogRecord & r, int v)
+		{
+			char buffer[16];
+			int n = snprintf(buffer, sizeof(buffer), "%d", v);
+			r.append(buffer, (size_t) n);
+		}
+		inline void stringify(LogRecord & r, bool v) { r.append(v ? "true" : "false"); }
 
 		// fallback for unknown type, print the type name
 		template<typename T>
-		inline ::std::string stringify(T const &v)
+		inline void stringify(LogRecord & r, T const &)
 		{
-			return "(Cannot stringify \"" + (::std::string)typeid(T).name() + "\")";
+			r.append("(Cannot stringify \"");
+			r.append(typeid(T).name());
+			r.append("\")");
 		}
 
 		// recursive variadic call
 		template<typename T, typename... A>
-		inline ::std::string stringify(T const& t, A const&... args)
+		inline void stringify(LogRecord & r, T const& t, A const&... args)
 		{
-			return stringify(t) + " " + stringify(args...);
+			stringify(r, t);
+			if (sizeof...(args) > 0) r.append(" ", 1);
+			stringify(r, args...);
 		}
 	}
-	// basic log function
+	// basic log function, only reached for lines that will be written
 	template<typename... A>
-	inline void _log(char const* file, int const line, A const&... args)
+	inline void _log(int level, char const* file, int const line, LogSite & site, A const&... args)
 	{
-		std::cout << std::string(file) << ": " << line << " - " << stringify(args...) << std::endl;
+		LogRecord r;
+		r.level = level;
+		r.length = 0;
+		r.text[0] = '\0';
+
+		char prefix[32];
+		r.append(file);
+		int n = snprintf(prefix, sizeof(prefix), ": %d - ", line);
+		r.append(prefix, (size_t) n);
+		stringify(r, args...);
+
+		int suppressed = site.takeSuppressed();
+		if (suppressed > 0)
+		{
+			n = snprintf(prefix, sizeof(prefix), " (%d more suppressed)", suppressed);
+			r.append(prefix, (size_t) n);
+		}
+
+		Log::write(r);
 	};
 }
 
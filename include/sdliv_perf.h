@@ -0,0 +1,164 @@
+#ifndef _SDLIV_PERF_H_
+#define _SDLIV_PERF_H_
+
+//build with -DSDLIV_NO_PERF and every timer and counter below compiles
+//to nothing, the summaries then all read zero
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace sdliv {
+	namespace perf {
+		//stages an image goes through from disk to screen, plus the
+		//directory scan; a stage can run inside another, create times
+		//the upload within it too
+		typedef enum
+		{
+			STAGE_DETECT, // sniffing the file type
+			STAGE_OPEN, // opening the file
+			STAGE_DECODE, // file to pixels, including any reduction
+			STAGE_CONVERT, // pixel format conversion
+			STAGE_CREATE, // Element::createFromSurface()
+			STAGE_UPLOAD, // pixels to texture
+			STAGE_DRAW, // texture to render target
+			STAGE_PRESENT, // SDL_RenderPresent
+			STAGE_SCAN, // FileHandler::openDirectory()
+			STAGE_COUNT
+		} Stage;
+
+		typedef enum
+		{
+			COUNTER_BYTES_DECODED, // pixel bytes out of the decoders
+			COUNTER_BYTES_UPLOADED, // pixel bytes into textures
+			COUNTER_COUNT
+		} Counter;
+
+		//percentiles come from log-linear buckets, within 1/8 of the value
+		typedef struct
+		{
+			::std::uint64_t count;
+			::std::uint64_t total_ns;
+			::std::uint64_t max_ns;
+			::std::uint64_t p50_ns;
+			::std::uint64_t p90_ns;
+			::std::uint64_t p99_ns;
+		} Summary;
+
+		const char * stageName(Stage stage);
+		const char * counterName(Counter counter);
+
+		// monotonic nanoseconds
+		inline ::std::uint64_t now()
+		{
+			return (::std::uint64_t) ::std::chrono::duration_cast<::std::chrono::nanoseconds>(
+					::std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+#ifndef SDLIV_NO_PERF
+		//each thread writes its own histograms, no locks or shared cache
+		//lines on the hot path; readers add up every thread's
+		void record(Stage stage, ::std::uint64_t ns);
+		void add(Counter counter, ::std::uint64_t n);
+
+		Summary getSummary(Stage stage);
+		::std::uint64_t getCounter(Counter counter);
+
+		//the most recent timing of a stage on any thread, 0 if none
+		::std::uint64_t getLast(Stage stage);
+
+		//zeroes everything, call it while nothing is being timed
+		void reset();
+
+		//a table of every stage and counter
+		int dump(FILE * out = stdout);
+
+		//SIGUSR1 dumps from a thread of its own; call init() before any
+		//other thread starts, so they all leave the signal to that one
+		//with SDLIV_TRACE=path in the environment init() starts a trace
+		//and quit() writes it to path
+		int init();
+		int quit();
+		bool isInit();
+
+		//the trace keeps the latest spans of each thread in a ring of its
+		//own, so recording takes no lock and never allocates after the first
+		//span names must be string literals, only the pointer is kept
+		bool isTracing();
+		void trace(const char * name, ::std::uint64_t start_ns, ::std::uint64_t end_ns, int arg = -1);
+
+		//shown for the calling thread's spans, a string literal too
+		void setThreadName(const char * name);
+
+		//Chrome trace event JSON, for chrome://tracing or ui.perfetto.dev
+		int writeTrace(const ::std::string & path);
+
+		// times its own lifetime into a stage, or until stop()
+		class ScopedTimer
+		{
+			private:
+				Stage stage;
+				::std::uint64_t start;
+
+			public:
+				ScopedTimer(Stage s) : stage(s), start(now()) {}
+				~ScopedTimer() { stop(); }
+
+				void stop()
+				{
+					if (start == 0) return;
+					record(stage, now() - start);
+					start = 0;
+				}
+		};
+
+		// a span in the trace for its own lifetime, nothing when not tracing
+		class Span
+		{
+			private:
+				const char * name;
+				::std::uint64_t start;
+				int arg;
+
+			public:
+				Span(const char * n, int a = -1) : name(n), start(isTracing() ? now() : 0), arg(a) {}
+				~Span() { if (start != 0) trace(name, start, now(), arg); }
+		};
+#else
+		inline void record(Stage, ::std::uint64_t) {}
+		inline void add(Counter, ::std::uint64_t) {}
+
+		inline Summary getSummary(Stage) { return Summary(); }
+		inline ::std::uint64_t getCounter(Counter) { return 0; }
+		inline ::std::uint64_t getLast(Stage) { return 0; }
+
+		inline void reset() {}
+		inline int dump(FILE * = stdout) { return -1; }
+
+		inline int init() { return 0; }
+		inline int quit() { return 0; }
+		inline bool isInit() { return false; }
+
+		inline bool isTracing() { return false; }
+		inline void trace(const char *, ::std::uint64_t, ::std::uint64_t, int = -1) {}
+		inline void setThreadName(const char *) {}
+		inline int writeTrace(const ::std::string &) { return -1; }
+
+		class ScopedTimer
+		{
+			public:
+				ScopedTimer(Stage) {}
+				void stop() {}
+		};
+
+		class Span
+		{
+			public:
+				Span(const char *, int = -1) {}
+		};
+#endif
+	}
+}
+
+#endif
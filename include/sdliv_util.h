@@ -0,0 +1,110 @@
+#ifndef _SDLIV_UTIL_H_
+#define _SDLIV_UTIL_H_
+
+//template functions need to be fully declared within header file
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace sdliv {
+	namespace util {
+		// natural ordering of file names, <0, 0 or >0 like strcmp
+		// ASCII is case folded and each run of digits compares as a length
+		// byte followed by the digits without leading zeros, so IMG_9 comes
+		// before IMG_10 and IMG_01 ties with IMG_1
+		int naturalCompare(::std::string_view a, ::std::string_view b);
+
+		// number of threads worth using for count items of parallel work
+		unsigned int workerCount(size_t count, size_t min_per_thread);
+
+		// shrink 32 bit pixels by averaging each channel over the block of
+		// source pixels under each destination pixel, rows [row_begin,
+		// row_end) of dst only so bands can go to different threads
+		// pitches are in bytes
+		void boxFilter(const ::std::uint32_t * src, int src_w, int src_h, int src_pitch,
+				::std::uint32_t * dst, int dst_w, int dst_h, int dst_pitch,
+				int row_begin, int row_end);
+
+		// boxFilter from packed 24 bit R, G, B pixels to ARGB8888, only
+		// the source rows under each destination row are expanded, so
+		// no 32 bit copy of the whole source is made
+		void boxFilterRGB24(const ::std::uint8_t * src, int src_w, int src_h, int src_pitch,
+				::std::uint32_t * dst, int dst_w, int dst_h, int dst_pitch,
+				int row_begin, int row_end);
+
+		// resize 32 bit pixels to exactly dst_w by dst_h, each destination
+		// pixel the average of the source area under it weighted by how
+		// much of each source pixel it covers, for shrinking only
+		// rows [row_begin, row_end) of dst, pitches in bytes
+		void areaResample(const ::std::uint32_t * src, int src_w, int src_h, int src_pitch,
+				::std::uint32_t * dst, int dst_w, int dst_h, int dst_pitch,
+				int row_begin, int row_end);
+
+		// expand count packed 24 bit R, G, B pixels to 32 bit ones with
+		// opaque alpha, as SDL's ARGB8888 or ABGR8888 on this machine
+		// uses AVX2 or SSSE3 when the CPU has them
+		void rgb24ToARGB(const ::std::uint8_t * src, ::std::uint32_t * dst, size_t count);
+		void rgb24ToABGR(const ::std::uint8_t * src, ::std::uint32_t * dst, size_t count);
+
+		// "avx2", "ssse3" or "scalar", whichever the functions above use
+		const char * pixelKernelName();
+
+		// call f(begin, end) on threads threads, each getting a contiguous
+		// slice of [0, count) of (count + threads - 1) / threads items
+		template<typename F>
+		void parallelFor(size_t count, unsigned int threads, F f)
+		{
+			if (threads <= 1)
+			{
+				f((size_t) 0, count);
+				return;
+			}
+
+			::std::vector<::std::thread> pool;
+			size_t slice = (count + threads - 1) / threads;
+			for (size_t begin = slice; begin < count; begin += slice)
+			{
+				pool.emplace_back(f, begin, ::std::min(begin + slice, count));
+			}
+
+			f((size_t) 0, ::std::min(slice, count));
+
+			for (auto & t : pool) t.join();
+		}
+
+		// std::sort on slices in parallel, then merge slices pairwise
+		template<typename T, typename C>
+		void parallelSort(::std::vector<T> & v, C comp)
+		{
+			const size_t min_per_thread = 16 * 1024;
+
+			unsigned int threads = workerCount(v.size(), min_per_thread);
+			if (threads <= 1)
+			{
+				::std::sort(v.begin(), v.end(), comp);
+				return;
+			}
+
+			size_t slice = (v.size() + threads - 1) / threads;
+			parallelFor(v.size(), threads, [&](size_t begin, size_t end)
+			{
+				::std::sort(v.begin() + begin, v.begin() + end, comp);
+			});
+
+			for (size_t width = slice; width < v.size(); width *= 2)
+			{
+				for (size_t begin = 0; begin + width < v.size(); begin += 2 * width)
+				{
+					size_t end = ::std::min(begin + 2 * width, v.size());
+					::std::inplace_merge(v.begin() + begin, v.begin() + begin + width, v.begin() + end, comp);
+				}
+			}
+		}
+	}
+}
+
+#endif
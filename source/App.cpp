@@ -15,11 +15,11 @@ int sdliv::App::_window_event_filter(void * param, SDL_Event * event)
 		switch (event->window.event)
 		{
 			case SDL_WINDOWEVENT_RESIZED:
-				log("SDL_WINDOWEVENT_RESIZED");
+				log_debug("SDL_WINDOWEVENT_RESIZED");
 				app->OnRender();
 				break;
 			case SDL_WINDOWEVENT_SIZE_CHANGED:
-				log("SDL_WINDOWEVENT_SIZE_CHANGED");
+				log_debug("SDL_WINDOWEVENT_SIZE_CHANGED");
 				app->OnRender();
 				break;
 			default:
@@ -38,6 +38,14 @@ sdliv::App::App()
 	active_element = nullptr;
 	window = nullptr;
 	font = nullptr;
+	grid = nullptr;
+	hud = nullptr;
+
+	view_fit = true;
+	view_zoom = 1.0;
+	view_x = view_y = 0.0;
+	dragging = false;
+	viewed_file = nullptr;
 }
 
 
@@ -59,6 +67,19 @@ sdliv::App::~App()
 
 bool sdliv::App::OnInit()
 {
+	//first, before SDL or anything else starts a thread
+	if (perf::init())
+	{
+		//not fatal, the timings are still dumped on exit
+		log("sdliv::App::OnInit() -- perf::init() failed");
+	}
+
+	if (Log::init())
+	{
+		//not fatal, log() writes synchronously instead
+		log("sdliv::App::OnInit() -- Log::init() failed");
+	}
+
 	Uint32 sdl_init_flags = 0;
 	sdl_init_flags |= SDL_INIT_TIMER;
 	sdl_init_flags |= SDL_INIT_VIDEO;
@@ -113,6 +134,33 @@ bool sdliv::App::OnInit()
 	font = Font::openFont(window, constants::font_path);
 	SDL_assert(font != nullptr);
 
+	if (Loader::init(constants::loader_thread_count, window->getNativeFormat()))
+	{
+		//not fatal, images will be decoded on the main thread instead
+		log("sdliv::App::OnInit() -- Loader::init() failed");
+	}
+
+	if (DirectoryWatcher::init())
+	{
+		//not fatal, FileHandler polls the directory instead
+		log("sdliv::App::OnInit() -- DirectoryWatcher::init() failed");
+	}
+
+	if (DirectoryScanner::init())
+	{
+		//not fatal, FileHandler scans directories synchronously instead
+		log("sdliv::App::OnInit() -- DirectoryScanner::init() failed");
+	}
+
+	if (ThumbnailStore::init())
+	{
+		//not fatal, there just won't be any thumbnails
+		log("sdliv::App::OnInit() -- ThumbnailStore::init() failed");
+	}
+
+	grid = new GridView(window);
+	hud = new Hud(window, font);
+
 	return false;
 }
 
@@ -199,28 +247,150 @@ void sdliv::App::OnLoop()
 
 void sdliv::App::OnRender()
 {
+	perf::Span span("App::OnRender");
+	const std::uint64_t frame_start = perf::now();
+
 	SDL_assert(window != nullptr);
-	SDL_assert(active_element != nullptr);
 
+	//a different image starts out fitted to the window, the same one
+	//swapped for its full resolution decode keeps the view
+	if (FileHandler::getActiveFile() != viewed_file)
+	{
+		viewed_file = FileHandler::getActiveFile();
+		view_fit = true;
+		dragging = false;
+	}
 
-	window->resizeElement(active_element);
-	window->centerElement(active_element);
+	//nullptr when every image in the directory has gone away
+	if (active_element != nullptr && view_fit)
+	{
+		window->resizeElement(active_element);
+		window->centerElement(active_element);
+	}
+	else if (active_element != nullptr)
+	{
+		window->viewElement(active_element, view_zoom, &view_x, &view_y);
+	}
+
+	//zoomed past what a reduced decode can show, fetch the real thing
+	if (active_element != nullptr && active_element->isReduced())
+	{
+		double magnification = active_element->getDrawScale()
+				* active_element->getWidth() / active_element->getDecodedWidth();
+		if (magnification > constants::full_decode_threshold) FileHandler::requestFullResolution();
+	}
+
+	//shrunk to fit, get a properly filtered copy rather than whatever
+	//the renderer's sampling makes of it
+	if (active_element != nullptr && view_fit
+			&& active_element->getDrawWidth() < active_element->getDecodedWidth())
+	{
+		FileHandler::requestScaled(active_element->getDrawWidth(), active_element->getDrawHeight());
+	}
 
 	if (window->clear())
 	{
 		log("onrender() failed at window->clear()");
 		log(SDL_GetError());
 	}
-	if (window->drawElement(active_element))
+	if (grid != nullptr && grid->isShown())
+	{
+		grid->draw();
+	}
+	else if (active_element != nullptr && window->drawElement(active_element))
 	{
 		log("onrender() failed at window->drawElement()");
 		log(SDL_GetError());
 	}
+	if (hud != nullptr && hud->isShown())
+	{
+		hud->draw();
+	}
 	if (window->present())
 	{
 		log("onrender() failed at window->present()");
 		log(SDL_GetError());
 	}
+
+	if (hud != nullptr) hud->setFrameTime(perf::now() - frame_start);
+}
+
+
+
+
+
+int sdliv::App::zoomAt(double factor, int x, int y)
+{
+	if (active_element == nullptr) return -1;
+
+	const double fit = window->getFitScale(active_element);
+	if (view_fit || FileHandler::getActiveFile() != viewed_file)
+	{
+		viewed_file = FileHandler::getActiveFile();
+		view_zoom = fit;
+		view_x = active_element->getWidth() / 2.0;
+		view_y = active_element->getHeight() / 2.0;
+	}
+
+	//image point under the cursor before and after must match
+	const double dx = x - window->getWidth() / 2.0;
+	const double dy = y - window->getHeight() / 2.0;
+	const double px = view_x + dx / view_zoom;
+	const double py = view_y + dy / view_zoom;
+
+	view_zoom = std::min(view_zoom * factor, constants::zoom_max);
+
+	//zooming out past the whole image goes back to fitting it
+	if (view_zoom <= fit && factor < 1.0)
+	{
+		view_fit = true;
+		return 0;
+	}
+
+	view_fit = false;
+	view_x = px - dx / view_zoom;
+	view_y = py - dy / view_zoom;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::App::toggleActualSize()
+{
+	if (active_element == nullptr) return -1;
+
+	if (!view_fit && view_zoom == 1.0)
+	{
+		view_fit = true;
+		return 0;
+	}
+
+	viewed_file = FileHandler::getActiveFile();
+	view_fit = false;
+	view_zoom = 1.0;
+	view_x = active_element->getWidth() / 2.0;
+	view_y = active_element->getHeight() / 2.0;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::App::panBy(int dx, int dy)
+{
+	//nothing to pan while the whole image is showing
+	if (active_element == nullptr || view_fit) return -1;
+
+	//viewElement() clamps it on the next render
+	view_x -= dx / view_zoom;
+	view_y -= dy / view_zoom;
+
+	return 0;
 }
 
 
@@ -230,26 +400,47 @@ void sdliv::App::OnRender()
 void sdliv::App::OnCleanup()
 {
 
-	//files and elements
+	//stop background work before the files it works on go away
+	if (Loader::isInit()) Loader::quit();
+	if (DirectoryWatcher::isInit()) DirectoryWatcher::quit();
+	if (DirectoryScanner::isInit()) DirectoryScanner::quit();
+	if (ThumbnailStore::isInit()) ThumbnailStore::quit();
+
+	//files and elements, the cache must let go before the window does
 	FileHandler::untrackAll();
+	ImageCache::clear();
 	active_element = nullptr;
 
+	//the grid's pool belongs to the window too
+	delete grid;
+	grid = nullptr;
 
-	//windows
-	SDL_assert(window != nullptr);
-	delete window;
-	window = nullptr;
+	//and the HUD's lines
+	delete hud;
+	hud = nullptr;
 
-	//fonts (include SDL2_ttf)
+
+	//fonts (include SDL2_ttf), their glyph atlases go with the renderer
 	SDL_assert(font != nullptr);
 	font->close();
 	delete font;
 	font = nullptr;
 	Font::quit();
 
+	//windows
+	SDL_assert(window != nullptr);
+	delete window;
+	window = nullptr;
+
 	//SDL2_image
 	IMG_Quit();
 
 	//SDL2
 	SDL_Quit();
+
+	//the last lines out before the timings
+	if (Log::isInit()) Log::quit();
+
+	perf::dump();
+	if (perf::isInit()) perf::quit();
 }
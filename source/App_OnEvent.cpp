@@ -6,6 +6,63 @@ void sdliv::App::OnEvent(SDL_Event * e)
 {
 	SDL_assert(e != nullptr);
 
+	//the event type goes along, to tell a keypress from a decoded image
+	perf::Span span("App::OnEvent", (int) e->type);
+
+	//user event types are assigned at runtime so they can't be case labels
+	if (e->type == Loader::getEventType())
+	{
+		if (FileHandler::onImageDecoded(e))
+		{
+			Element * next = FileHandler::getActiveImage();
+			if (next != nullptr) active_element = next;
+			OnRender();
+		}
+		return;
+	}
+
+	if (e->type == DirectoryWatcher::getEventType())
+	{
+		if (FileHandler::onDirectoryChanged(e))
+		{
+			active_element = FileHandler::getActiveImage();
+			OnRender();
+		}
+		else if (grid->isShown())
+		{
+			grid->invalidate();
+			OnRender();
+		}
+		return;
+	}
+
+	if (e->type == DirectoryScanner::getEventType())
+	{
+		if (FileHandler::onDirectoryScanned(e))
+		{
+			active_element = FileHandler::getActiveImage();
+			OnRender();
+		}
+		else if (grid->isShown())
+		{
+			grid->invalidate();
+			OnRender();
+		}
+		return;
+	}
+
+	if (e->type == ThumbnailStore::getEventType())
+	{
+		if (FileHandler::onThumbnailsStored(e) && grid->isShown())
+		{
+			grid->refreshMissing();
+			OnRender();
+		}
+		return;
+	}
+
+	Element * next = nullptr;
+
 	switch (e->type)
 	{
 		/*
@@ -65,15 +122,148 @@ void sdliv::App::OnEvent(SDL_Event * e)
 			}
 			break;
 			*/
+		case SDL_RENDER_TARGETS_RESET:
+			//nothing renders to a texture, a redraw is enough
+			OnRender();
+			break;
+		case SDL_RENDER_DEVICE_RESET:
+			log("SDL_RENDER_DEVICE_RESET, restoring textures");
+			window->restoreTextures();
+			Font::restoreTextures();
+			ImageCache::recount();
+			grid->invalidate();
+			OnRender();
+			break;
+		case SDL_MOUSEWHEEL:
+			if (grid->isShown())
+			{
+				grid->scrollBy(-e->wheel.y * constants::thumbnail_size / 2);
+				OnRender();
+			}
+			else if (e->wheel.y != 0)
+			{
+				//zoom around the cursor
+				int x, y;
+				SDL_GetMouseState(&x, &y);
+				zoomAt((e->wheel.y > 0) ? constants::zoom_step : 1.0 / constants::zoom_step, x, y);
+				OnRender();
+			}
+			break;
+		case SDL_MOUSEBUTTONDOWN:
+			if (!grid->isShown() && e->button.button == SDL_BUTTON_LEFT) dragging = true;
+			break;
+		case SDL_MOUSEBUTTONUP:
+			if (e->button.button == SDL_BUTTON_LEFT) dragging = false;
+			break;
+		case SDL_MOUSEMOTION:
+			if (dragging && (e->motion.state & SDL_BUTTON_LMASK) && panBy(e->motion.xrel, e->motion.yrel) == 0)
+			{
+				OnRender();
+			}
+			break;
 		case SDL_KEYDOWN:
+			if (grid->isShown())
+			{
+				switch (e->key.keysym.sym)
+				{
+					case SDLK_RETURN:
+						next = FileHandler::jumpToIndex(grid->getSelected());
+						if (next != nullptr) active_element = next;
+						grid->hide();
+						OnRender();
+						break;
+					case SDLK_g:
+					case SDLK_ESCAPE:
+						grid->hide();
+						OnRender();
+						break;
+					case SDLK_s:
+						FileHandler::setSortOrder((SortOrder) ((FileHandler::getSortOrder() + 1) % SORT_COUNT));
+						grid->invalidate();
+						OnRender();
+						break;
+					case SDLK_h:
+						hud->toggle();
+						OnRender();
+						break;
+					case SDLK_q:
+						Running = false;
+						break;
+					default:
+						if (grid->onKey(e->key.keysym.sym)) OnRender();
+						break;
+				}
+				break;
+			}
+
 			switch (e->key.keysym.sym)
 			{
+				//nullptr means the image is still decoding, keep showing
+				//the old one until onImageDecoded() says it's ready
 				case SDLK_LEFT:
-					active_element = FileHandler::prevImage();
+					next = FileHandler::prevImage();
+					if (next != nullptr) active_element = next;
 					OnRender();
 					break;
 				case SDLK_RIGHT:
-					active_element = FileHandler::nextImage();
+					next = FileHandler::nextImage();
+					if (next != nullptr) active_element = next;
+					OnRender();
+					break;
+				case SDLK_HOME:
+					next = FileHandler::firstImage();
+					if (next != nullptr) active_element = next;
+					OnRender();
+					break;
+				case SDLK_END:
+					next = FileHandler::lastImage();
+					if (next != nullptr) active_element = next;
+					OnRender();
+					break;
+				case SDLK_PAGEUP:
+					next = FileHandler::stepImage(-constants::page_step);
+					if (next != nullptr) active_element = next;
+					OnRender();
+					break;
+				case SDLK_PAGEDOWN:
+					next = FileHandler::stepImage(constants::page_step);
+					if (next != nullptr) active_element = next;
+					OnRender();
+					break;
+				//number keys jump to 0%, 10%, ... 90% of the way through
+				case SDLK_0: case SDLK_1: case SDLK_2: case SDLK_3: case SDLK_4:
+				case SDLK_5: case SDLK_6: case SDLK_7: case SDLK_8: case SDLK_9:
+					next = FileHandler::jumpToFraction((e->key.keysym.sym - SDLK_0) / 10.0);
+					if (next != nullptr) active_element = next;
+					OnRender();
+					break;
+				case SDLK_s:
+					//cycle name, mtime, size, extension
+					FileHandler::setSortOrder((SortOrder) ((FileHandler::getSortOrder() + 1) % SORT_COUNT));
+					break;
+				case SDLK_g:
+					grid->show();
+					OnRender();
+					break;
+				case SDLK_PLUS:
+				case SDLK_EQUALS:
+				case SDLK_KP_PLUS:
+					zoomAt(constants::zoom_step, window->getWidth() / 2, window->getHeight() / 2);
+					OnRender();
+					break;
+				case SDLK_MINUS:
+				case SDLK_KP_MINUS:
+					zoomAt(1.0 / constants::zoom_step, window->getWidth() / 2, window->getHeight() / 2);
+					OnRender();
+					break;
+				case SDLK_f:
+					//1:1, again to fit
+					toggleActualSize();
+					OnRender();
+					break;
+				case SDLK_h:
+					//performance overlay
+					hud->toggle();
 					OnRender();
 					break;
 				case SDLK_q:
@@ -0,0 +1,524 @@
+#include <sdliv.h>
+
+#ifndef WIN32
+#include <cstdio>
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+
+#ifndef WIN32
+//libjpeg's default error handler calls exit(), jump back out instead
+typedef struct
+{
+	jpeg_error_mgr manager;
+	jmp_buf jump;
+} JpegError;
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+	longjmp(((JpegError*) cinfo->err)->jump, 1);
+}
+
+static void jpegOutputMessage(j_common_ptr cinfo)
+{
+	//warnings about corrupt data, IMG_Load doesn't print them either
+}
+
+//libjpeg output whose bytes in memory match an SDL format
+static bool jpegSpaceFor(Uint32 format, J_COLOR_SPACE * space)
+{
+	switch (format)
+	{
+		case SDL_PIXELFORMAT_RGB24: *space = JCS_RGB; return true;
+#ifdef JCS_EXTENSIONS
+		case SDL_PIXELFORMAT_BGR24: *space = JCS_EXT_BGR; return true;
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		case SDL_PIXELFORMAT_ARGB8888: *space = JCS_EXT_BGRA; return true;
+		case SDL_PIXELFORMAT_RGB888: *space = JCS_EXT_BGRX; return true;
+		case SDL_PIXELFORMAT_ABGR8888: *space = JCS_EXT_RGBA; return true;
+		case SDL_PIXELFORMAT_BGR888: *space = JCS_EXT_RGBX; return true;
+#else
+		case SDL_PIXELFORMAT_ARGB8888: *space = JCS_EXT_ARGB; return true;
+		case SDL_PIXELFORMAT_RGB888: *space = JCS_EXT_XRGB; return true;
+		case SDL_PIXELFORMAT_ABGR8888: *space = JCS_EXT_ABGR; return true;
+		case SDL_PIXELFORMAT_BGR888: *space = JCS_EXT_XBGR; return true;
+#endif
+#endif
+		default: return false;
+	}
+}
+
+//4 bytes per pixel, one per channel, so the box filter can average them
+static bool isByteQuad(Uint32 format)
+{
+	switch (format)
+	{
+		case SDL_PIXELFORMAT_ARGB8888:
+		case SDL_PIXELFORMAT_ABGR8888:
+		case SDL_PIXELFORMAT_RGBA8888:
+		case SDL_PIXELFORMAT_BGRA8888:
+		case SDL_PIXELFORMAT_RGB888:
+		case SDL_PIXELFORMAT_BGR888:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//a new width by height area resampled copy of s, which must be byte quad
+static SDL_Surface * areaResampled(const SDL_Surface * s, int width, int height)
+{
+	SDL_Surface * dst = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, s->format->format);
+	if (dst == nullptr)
+	{
+		log("sdliv::Decoder -- SDL_CreateRGBSurfaceWithFormat() failed", SDL_GetError());
+		return nullptr;
+	}
+
+	sdliv::util::parallelFor((size_t) height, sdliv::util::workerCount((size_t) height, 64), [&](size_t begin, size_t end)
+	{
+		sdliv::util::areaResample((const Uint32*) s->pixels, s->w, s->h, s->pitch,
+				(Uint32*) dst->pixels, width, height, dst->pitch, (int) begin, (int) end);
+	});
+
+	return dst;
+}
+
+static bool isJPEG(FILE * f)
+{
+	unsigned char magic[3] = { 0, 0, 0 };
+	bool jpeg = fread(magic, 1, 3, f) == 3
+			&& magic[0] == 0xff && magic[1] == 0xd8 && magic[2] == 0xff;
+
+	rewind(f);
+	return jpeg;
+}
+#endif
+
+
+
+
+
+int sdliv::Decoder::reductionFor(int width, int height, int target_width, int target_height)
+{
+	if (target_width <= 0 || target_height <= 0) return 1;
+
+	//largest power of two that keeps the image at least as big as it
+	//is drawn when fitted to the target
+	double limit = std::max(((double) width) / target_width, ((double) height) / target_height);
+
+	int reduction = 1;
+	while (reduction * 2 <= limit) reduction *= 2;
+
+	return reduction;
+}
+
+
+
+
+
+SDL_Surface * sdliv::Decoder::decode(const std::string & path, int target_width, int target_height,
+		int * full_width, int * full_height, Uint32 format)
+{
+	SDL_assert(full_width != nullptr && full_height != nullptr);
+
+	//convert() times itself, only the decode counts here
+	perf::ScopedTimer timer(perf::STAGE_DECODE);
+
+#ifndef WIN32
+	//only worth a look when there's something to save
+	if (target_width > 0 && target_height > 0)
+	{
+		FILE * f = fopen(path.c_str(), "rb");
+		if (f != nullptr)
+		{
+			SDL_Surface * s = nullptr;
+			if (isJPEG(f)) s = decodeJPEG(f, target_width, target_height, format, full_width, full_height);
+
+			fclose(f);
+			if (s != nullptr)
+			{
+				timer.stop();
+				perf::add(perf::COUNTER_BYTES_DECODED, (std::uint64_t) s->pitch * s->h);
+				return convert(s, format);
+			}
+		}
+	}
+#endif
+
+	SDL_Surface * s = IMG_Load(path.c_str());
+	if (s == nullptr) return nullptr;
+
+	*full_width = s->w;
+	*full_height = s->h;
+
+	int reduction = reductionFor(s->w, s->h, target_width, target_height);
+	perf::add(perf::COUNTER_BYTES_DECODED, (std::uint64_t) s->pitch * s->h);
+	if (reduction > 1) s = shrink(s, reduction);
+
+	timer.stop();
+	return convert(s, format);
+}
+
+
+
+
+
+SDL_Surface * sdliv::Decoder::decodeJPEG(FILE * f, int target_width, int target_height, Uint32 format,
+		int * full_width, int * full_height)
+{
+#ifndef WIN32
+	jpeg_decompress_struct cinfo;
+	JpegError error;
+	SDL_Surface * volatile s = nullptr;
+
+	cinfo.err = jpeg_std_error(&error.manager);
+	error.manager.error_exit = jpegErrorExit;
+	error.manager.output_message = jpegOutputMessage;
+
+	if (setjmp(error.jump))
+	{
+		//caller falls back to IMG_Load, which may cope or report it
+		jpeg_destroy_decompress(&cinfo);
+		if (s != nullptr) SDL_FreeSurface(s);
+		return nullptr;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, f);
+	jpeg_read_header(&cinfo, TRUE);
+
+	//no 4 channel output for these, leave them to SDL_image
+	if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK)
+	{
+		jpeg_destroy_decompress(&cinfo);
+		return nullptr;
+	}
+
+	*full_width = (int) cinfo.image_width;
+	*full_height = (int) cinfo.image_height;
+
+	//the IDCT can skip straight to 1/2, 1/4 or 1/8 size, which saves
+	//most of the decode as well as the memory
+	const int reduction = reductionFor(*full_width, *full_height, target_width, target_height);
+	const int dct_reduction = std::min(reduction, 8);
+
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = dct_reduction;
+
+	//straight into the format asked for if libjpeg can write it and
+	//shrink() can filter it, ARGB8888 or failing that RGB24 if not
+	J_COLOR_SPACE space;
+	if (!isByteQuad(format) || !jpegSpaceFor(format, &space))
+	{
+		format = SDL_PIXELFORMAT_ARGB8888;
+		if (!jpegSpaceFor(format, &space)) format = SDL_PIXELFORMAT_RGB24;
+		jpegSpaceFor(format, &space);
+	}
+
+	//a panorama that's too big at 4 bytes a pixel may still fit at 3
+	cinfo.out_color_space = space;
+	jpeg_calc_output_dimensions(&cinfo);
+	if (format != SDL_PIXELFORMAT_RGB24 && !fitsSurface((int) cinfo.output_width, (int) cinfo.output_height, 4))
+	{
+		format = SDL_PIXELFORMAT_RGB24;
+		jpegSpaceFor(format, &space);
+		cinfo.out_color_space = space;
+	}
+	const int depth = (format == SDL_PIXELFORMAT_RGB24) ? 24 : 32;
+
+	jpeg_start_decompress(&cinfo);
+
+	s = SDL_CreateRGBSurfaceWithFormat(0, cinfo.output_width, cinfo.output_height, depth, format);
+	if (s == nullptr)
+	{
+		log("sdliv::Decoder::decodeJPEG() -- SDL_CreateRGBSurfaceWithFormat() failed", SDL_GetError());
+		jpeg_destroy_decompress(&cinfo);
+		return nullptr;
+	}
+
+	while (cinfo.output_scanline < cinfo.output_height)
+	{
+		JSAMPROW row = (JSAMPROW) ((Uint8*) s->pixels + (size_t) cinfo.output_scanline * s->pitch);
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	SDL_Surface * decoded = s;
+	int remaining = reduction / dct_reduction;
+	return (remaining > 1) ? shrink(decoded, remaining) : decoded;
+#else
+	return nullptr;
+#endif
+}
+
+
+
+
+
+SDL_Surface * sdliv::Decoder::shrink(SDL_Surface * s, int reduction)
+{
+	SDL_assert(s != nullptr);
+
+	//rounded up, as libjpeg's scaled IDCT does, so the result is never
+	//smaller than the target reductionFor() picked it for
+	int w = std::max(1, (s->w + reduction - 1) / reduction);
+	int h = std::max(1, (s->h + reduction - 1) / reduction);
+
+	//expanded a few rows at a time, all of it as ARGB8888 may be more
+	//than SDL allows in one surface
+	if (s->format->format == SDL_PIXELFORMAT_RGB24)
+	{
+		SDL_Surface * dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+		if (dst == nullptr)
+		{
+			log("sdliv::Decoder::shrink() -- SDL_CreateRGBSurfaceWithFormat() failed");
+			return s;
+		}
+
+		util::parallelFor((size_t) h, util::workerCount((size_t) h, 64), [&](size_t begin, size_t end)
+		{
+			util::boxFilterRGB24((const Uint8*) s->pixels, s->w, s->h, s->pitch,
+					(Uint32*) dst->pixels, w, h, dst->pitch, (int) begin, (int) end);
+		});
+
+		SDL_FreeSurface(s);
+		return dst;
+	}
+
+	if (!isByteQuad(s->format->format))
+	{
+		s = convert(s, SDL_PIXELFORMAT_ARGB8888);
+
+		//still drawable, just bigger than it needed to be
+		if (!isByteQuad(s->format->format)) return s;
+	}
+
+	SDL_Surface * dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, s->format->format);
+	if (dst == nullptr)
+	{
+		log("sdliv::Decoder::shrink() -- SDL_CreateRGBSurfaceWithFormat() failed");
+		return s;
+	}
+
+	util::boxFilter((const Uint32*) s->pixels, s->w, s->h, s->pitch,
+			(Uint32*) dst->pixels, w, h, dst->pitch, 0, h);
+
+	SDL_FreeSurface(s);
+	return dst;
+}
+
+
+
+
+
+SDL_Surface * sdliv::Decoder::resample(SDL_Surface * s, int width, int height)
+{
+	if (s == nullptr || width <= 0 || height <= 0) return s;
+	if ((s->w == width && s->h == height) || width > s->w || height > s->h) return s;
+
+	if (!isByteQuad(s->format->format))
+	{
+		s = convert(s, SDL_PIXELFORMAT_ARGB8888);
+		if (!isByteQuad(s->format->format)) return s;
+	}
+
+	SDL_Surface * dst = areaResampled(s, width, height);
+	if (dst == nullptr) return s;
+
+	SDL_FreeSurface(s);
+	return dst;
+}
+
+
+
+
+
+SDL_Surface * sdliv::Decoder::resampleToFit(const SDL_Surface * s, int full_width, int full_height,
+		int box_width, int box_height)
+{
+	if (s == nullptr || full_width <= 0 || full_height <= 0 || box_width <= 0 || box_height <= 0) return nullptr;
+	if (!isByteQuad(s->format->format)) return nullptr;
+
+	//the same sums as Window::getFitScale() and Element::setDrawScale()
+	double x_scale = ((double) box_width) / ((double) full_width);
+	double y_scale = ((double) box_height) / ((double) full_height);
+	double scale = (x_scale < y_scale) ? x_scale : y_scale;
+
+	int width = (int) (scale * full_width + 0.5);
+	int height = (int) (scale * full_height + 0.5);
+
+	if (width <= 0 || height <= 0 || width >= s->w || height > s->h) return nullptr;
+
+	return areaResampled(s, width, height);
+}
+
+
+
+
+
+SDL_Surface * sdliv::Decoder::convert(SDL_Surface * s, Uint32 format)
+{
+	if (s == nullptr || format == SDL_PIXELFORMAT_UNKNOWN || s->format->format == format) return s;
+
+	//TiledElement expands it a tile at a time instead
+	if (!fitsSurface(s->w, s->h, SDL_BYTESPERPIXEL(format)))
+	{
+		log_debug("sdliv::Decoder::convert() -- too big to convert, keeping", s->w, "by", s->h);
+		return s;
+	}
+
+	perf::ScopedTimer timer(perf::STAGE_CONVERT);
+
+	SDL_Surface * dst = nullptr;
+
+	//what IMG_Load gives for most JPEGs and PNGs, a byte shuffle away
+	//from what renderers want
+	const bool to_argb = (format == SDL_PIXELFORMAT_ARGB8888 || format == SDL_PIXELFORMAT_RGB888);
+	const bool to_abgr = (format == SDL_PIXELFORMAT_ABGR8888 || format == SDL_PIXELFORMAT_BGR888);
+	if (s->format->format == SDL_PIXELFORMAT_RGB24 && (to_argb || to_abgr))
+	{
+		dst = SDL_CreateRGBSurfaceWithFormat(0, s->w, s->h, 32, format);
+		if (dst != nullptr)
+		{
+			for (int y = 0; y < s->h; y++)
+			{
+				const Uint8 * in = (const Uint8*) s->pixels + (size_t) y * s->pitch;
+				Uint32 * out = (Uint32*) ((Uint8*) dst->pixels + (size_t) y * dst->pitch);
+
+				if (to_argb) util::rgb24ToARGB(in, out, (size_t) s->w);
+				else util::rgb24ToABGR(in, out, (size_t) s->w);
+			}
+		}
+	}
+	else
+	{
+		dst = SDL_ConvertSurfaceFormat(s, format, 0);
+	}
+
+	if (dst == nullptr)
+	{
+		//the upload will convert instead, on the main thread
+		log("sdliv::Decoder::convert() -- conversion failed", SDL_GetError());
+		return s;
+	}
+
+	SDL_FreeSurface(s);
+	return dst;
+}
+
+
+
+
+
+bool sdliv::Decoder::fitsSurface(int width, int height, int bytes_per_pixel)
+{
+	if (width <= 0 || height <= 0 || bytes_per_pixel <= 0) return false;
+
+	const Sint64 pitch = ((Sint64) width * bytes_per_pixel + 3) & ~(Sint64) 3;
+	return pitch * height <= SDL_MAX_SINT32;
+}
+
+
+
+
+
+bool sdliv::Decoder::canDecodeInto(Uint32 format)
+{
+#ifndef WIN32
+	J_COLOR_SPACE space;
+	return jpegSpaceFor(format, &space);
+#else
+	return false;
+#endif
+}
+
+
+
+
+
+int sdliv::Decoder::decodeInto(const std::string & path, int target_width, int target_height,
+		Uint32 format, const RowSink & sink, int * full_width, int * full_height)
+{
+	SDL_assert(full_width != nullptr && full_height != nullptr);
+
+#ifndef WIN32
+	J_COLOR_SPACE space;
+	if (!jpegSpaceFor(format, &space)) return -1;
+
+	//the rows land in texture memory, so this is the upload as well
+	perf::ScopedTimer timer(perf::STAGE_DECODE);
+
+	FILE * f = fopen(path.c_str(), "rb");
+	if (f == nullptr) return -1;
+
+	if (!isJPEG(f))
+	{
+		fclose(f);
+		return -1;
+	}
+
+	jpeg_decompress_struct cinfo;
+	JpegError error;
+
+	cinfo.err = jpeg_std_error(&error.manager);
+	error.manager.error_exit = jpegErrorExit;
+	error.manager.output_message = jpegOutputMessage;
+
+	if (setjmp(error.jump))
+	{
+		jpeg_destroy_decompress(&cinfo);
+		fclose(f);
+		return -1;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, f);
+	jpeg_read_header(&cinfo, TRUE);
+
+	if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK)
+	{
+		jpeg_destroy_decompress(&cinfo);
+		fclose(f);
+		return -1;
+	}
+
+	*full_width = (int) cinfo.image_width;
+	*full_height = (int) cinfo.image_height;
+
+	//no surface to box filter, the scaled IDCT is all there is
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = std::min(reductionFor(*full_width, *full_height, target_width, target_height), 8);
+	cinfo.out_color_space = space;
+
+	jpeg_start_decompress(&cinfo);
+
+	int pitch = 0;
+	Uint8 * pixels = (Uint8*) sink((int) cinfo.output_width, (int) cinfo.output_height, &pitch);
+	if (pixels == nullptr)
+	{
+		jpeg_destroy_decompress(&cinfo);
+		fclose(f);
+		return -1;
+	}
+
+	while (cinfo.output_scanline < cinfo.output_height)
+	{
+		JSAMPROW row = (JSAMPROW) (pixels + (size_t) cinfo.output_scanline * pitch);
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+
+	perf::add(perf::COUNTER_BYTES_DECODED, (std::uint64_t) pitch * cinfo.output_height);
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	fclose(f);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
@@ -0,0 +1,420 @@
+#include <sdliv.h>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+
+bool sdliv::DirectoryScanner::module_initialized = false;
+Uint32 sdliv::DirectoryScanner::event_type = (Uint32) -1;
+std::thread sdliv::DirectoryScanner::scanner;
+std::atomic<bool> sdliv::DirectoryScanner::cancelled(false);
+std::atomic<bool> sdliv::DirectoryScanner::scanning(false);
+std::atomic<int> sdliv::DirectoryScanner::generation(0);
+std::atomic<size_t> sdliv::DirectoryScanner::scanned_count(0);
+std::atomic<size_t> sdliv::DirectoryScanner::matched_count(0);
+
+std::set<std::string> sdliv::DirectoryScanner::extensions = std::set<std::string>();
+bool sdliv::DirectoryScanner::recursive = false;
+int sdliv::DirectoryScanner::max_depth = -1;
+
+std::vector<sdliv::DirectoryScanner::Directory> sdliv::DirectoryScanner::directories
+		= std::vector<sdliv::DirectoryScanner::Directory>();
+int sdliv::DirectoryScanner::busy_workers = 0;
+std::mutex sdliv::DirectoryScanner::directories_mutex;
+std::condition_variable sdliv::DirectoryScanner::directories_cv;
+std::set<std::pair<Uint64, Uint64>> sdliv::DirectoryScanner::visited = std::set<std::pair<Uint64, Uint64>>();
+
+std::vector<std::string> sdliv::DirectoryScanner::subtree_names = std::vector<std::string>();
+std::vector<size_t> sdliv::DirectoryScanner::subtree_counts = std::vector<size_t>();
+std::mutex sdliv::DirectoryScanner::progress_mutex;
+
+
+
+
+
+int sdliv::DirectoryScanner::init()
+{
+	if (module_initialized)
+	{
+		log("sdliv::DirectoryScanner::init() called while already initialized");
+		return -1;
+	}
+
+	event_type = SDL_RegisterEvents(1);
+	if (event_type == (Uint32) -1)
+	{
+		log("sdliv::DirectoryScanner::init() -- SDL_RegisterEvents() failed");
+		return -1;
+	}
+
+	module_initialized = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::DirectoryScanner::quit()
+{
+	if (!module_initialized)
+	{
+		log("sdliv::DirectoryScanner::quit() called while module uninitialized");
+		return -1;
+	}
+
+	cancel();
+
+	//free batches that were posted but never consumed
+	SDL_Event e;
+	while (SDL_PeepEvents(&e, 1, SDL_GETEVENT, event_type, event_type) > 0)
+	{
+		delete (Batch*) e.user.data1;
+	}
+
+	module_initialized = false;
+	return 0;
+}
+
+
+
+
+
+bool sdliv::DirectoryScanner::isInit()
+{
+	return module_initialized;
+}
+
+
+
+
+
+int sdliv::DirectoryScanner::scan(const std::filesystem::path & dir, const std::set<std::string> & exts,
+		bool recurse, int depth_limit)
+{
+	if (!module_initialized) return -1;
+
+	cancel();
+
+	cancelled = false;
+	scanning = true;
+	scanned_count = 0;
+	matched_count = 0;
+
+	extensions = exts;
+	recursive = recurse;
+	max_depth = depth_limit;
+
+	directories.clear();
+	busy_workers = 0;
+	visited.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex);
+		subtree_names.assign(1, ".");
+		subtree_counts.assign(1, 0);
+	}
+
+	markVisited(dir);
+	directories.push_back({ dir, 0, 0 });
+
+	int gen = ++generation;
+	scanner = std::thread(work, gen);
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::DirectoryScanner::cancel()
+{
+	if (!scanner.joinable()) return -1;
+
+	{
+		//under the lock so a worker can't miss it between check and wait
+		std::lock_guard<std::mutex> lock(directories_mutex);
+		cancelled = true;
+	}
+	directories_cv.notify_all();
+
+	scanner.join();
+	scanning = false;
+
+	return 0;
+}
+
+
+
+
+
+bool sdliv::DirectoryScanner::isScanning()
+{
+	return scanning;
+}
+
+
+
+
+
+int sdliv::DirectoryScanner::getGeneration()
+{
+	return generation;
+}
+
+
+
+
+
+size_t sdliv::DirectoryScanner::getScannedCount()
+{
+	return scanned_count;
+}
+
+
+
+
+
+size_t sdliv::DirectoryScanner::getMatchedCount()
+{
+	return matched_count;
+}
+
+
+
+
+
+Uint32 sdliv::DirectoryScanner::getEventType()
+{
+	return event_type;
+}
+
+
+
+
+
+int sdliv::DirectoryScanner::post(Batch * batch)
+{
+	SDL_Event e;
+	SDL_zero(e);
+	e.type = event_type;
+	e.user.code = batch->generation;
+	e.user.data1 = batch;
+
+	if (SDL_PushEvent(&e) != 1)
+	{
+		log("sdliv::DirectoryScanner::post() -- SDL_PushEvent() failed", SDL_GetError());
+		delete batch;
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+
+
+std::vector<std::pair<std::string, size_t>> sdliv::DirectoryScanner::getSubtreeProgress()
+{
+	std::lock_guard<std::mutex> lock(progress_mutex);
+
+	std::vector<std::pair<std::string, size_t>> progress;
+	progress.reserve(subtree_names.size());
+	for (size_t i = 0; i < subtree_names.size(); i++)
+	{
+		progress.emplace_back(subtree_names[i], subtree_counts[i]);
+	}
+
+	return progress;
+}
+
+
+
+
+
+bool sdliv::DirectoryScanner::markVisited(const std::filesystem::path & dir)
+{
+	std::pair<Uint64, Uint64> id;
+
+#ifndef WIN32
+	//stat() follows symlinks, so every route to a directory gives one id
+	struct stat st;
+	if (stat(dir.c_str(), &st) != 0) return false;
+	id = { (Uint64) st.st_dev, (Uint64) st.st_ino };
+#else
+	std::error_code ec;
+	std::filesystem::path canonical = std::filesystem::canonical(dir, ec);
+	if (ec) return false;
+	id = { 0, (Uint64) std::hash<std::string>()(canonical.string()) };
+#endif
+
+	std::lock_guard<std::mutex> lock(directories_mutex);
+	return visited.insert(id).second;
+}
+
+
+
+
+
+void sdliv::DirectoryScanner::work(int gen)
+{
+	std::vector<std::thread> helpers;
+
+	if (recursive)
+	{
+		for (int i = 1; i < constants::scanner_thread_count; i++)
+		{
+			helpers.emplace_back(listDirectories, gen);
+		}
+	}
+
+	listDirectories(gen);
+
+	for (auto & t : helpers)
+	{
+		t.join();
+	}
+
+	//every worker has posted what it found, tell the main thread it's done
+	post(new Batch{ gen, true, {} });
+
+	scanning = false;
+}
+
+
+
+
+
+void sdliv::DirectoryScanner::listDirectories(int gen)
+{
+	perf::setThreadName("DirectoryScanner");
+
+	//small first batch so browsing starts quickly, bigger ones later so
+	//the main thread merges into tracked_files fewer times
+	size_t batch_size = 256;
+
+	Batch * batch = new Batch{ gen, false, {} };
+	batch->entries.reserve(batch_size);
+
+	while (true)
+	{
+		Directory d;
+
+		{
+			//wait while other workers may still push subdirectories
+			std::unique_lock<std::mutex> lock(directories_mutex);
+			directories_cv.wait(lock, []{ return cancelled || !directories.empty() || busy_workers == 0; });
+
+			if (cancelled || directories.empty()) break;
+
+			d = std::move(directories.back());
+			directories.pop_back();
+			busy_workers++;
+		}
+
+		{
+			perf::Span span("DirectoryScanner::listDirectory");
+			listDirectory(d, batch, batch_size);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(directories_mutex);
+			busy_workers--;
+		}
+		directories_cv.notify_all();
+	}
+
+	directories_cv.notify_all();
+
+	if (batch->entries.empty()) delete batch;
+	else post(batch);
+}
+
+
+
+
+
+int sdliv::DirectoryScanner::listDirectory(const Directory & d, Batch *& batch, size_t & batch_size)
+{
+	const size_t max_batch_size = 16 * 1024;
+	const bool descend = recursive && (max_depth < 0 || d.depth < max_depth);
+
+	size_t matched = 0;
+
+	std::error_code ec;
+	std::filesystem::directory_iterator iter(d.path, std::filesystem::directory_options::skip_permission_denied, ec);
+	if (ec)
+	{
+		log("sdliv::DirectoryScanner::listDirectory() -- failed to open directory", d.path.string());
+		return -1;
+	}
+
+	for (; !ec && iter != std::filesystem::directory_iterator(); iter.increment(ec))
+	{
+		if (cancelled) break;
+
+		scanned_count++;
+
+		//is_regular_file() uses the type readdir already gave us
+		const std::filesystem::directory_entry & f = *iter;
+
+		if (descend && f.is_directory(ec) && !ec)
+		{
+			if (!markVisited(f.path())) continue;
+
+			size_t subtree = d.subtree;
+			if (d.depth == 0)
+			{
+				std::lock_guard<std::mutex> lock(progress_mutex);
+				subtree = subtree_names.size();
+				subtree_names.push_back(f.path().filename().string());
+				subtree_counts.push_back(0);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(directories_mutex);
+				directories.push_back({ f.path(), d.depth + 1, subtree });
+			}
+			directories_cv.notify_one();
+			continue;
+		}
+
+		if (!f.is_regular_file(ec) || ec)
+		{
+			ec.clear();
+			continue;
+		}
+
+		if (extensions.count(f.path().extension().string()) == 0) continue;
+
+		matched_count++;
+		matched++;
+		batch->entries.push_back(f);
+
+		if (batch->entries.size() >= batch_size)
+		{
+			//the main thread owns batch once it's posted
+			int gen = batch->generation;
+			post(batch);
+
+			batch_size = std::min(batch_size * 2, max_batch_size);
+			batch = new Batch{ gen, false, {} };
+			batch->entries.reserve(batch_size);
+		}
+	}
+
+	if (ec)
+	{
+		log("sdliv::DirectoryScanner::listDirectory() -- error while scanning", d.path.string());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex);
+		subtree_counts[d.subtree] += matched;
+	}
+
+	return 0;
+}
@@ -0,0 +1,262 @@
+#include <sdliv.h>
+
+#ifndef WIN32
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+
+bool sdliv::DirectoryWatcher::module_initialized = false;
+Uint32 sdliv::DirectoryWatcher::event_type = (Uint32) -1;
+int sdliv::DirectoryWatcher::inotify_fd = -1;
+int sdliv::DirectoryWatcher::watch_descriptor = -1;
+int sdliv::DirectoryWatcher::wake_pipe[2] = { -1, -1 };
+std::thread sdliv::DirectoryWatcher::watcher;
+std::filesystem::path sdliv::DirectoryWatcher::watched_directory = std::filesystem::path();
+std::atomic<bool> sdliv::DirectoryWatcher::watch_lost(false);
+
+
+
+
+
+int sdliv::DirectoryWatcher::init()
+{
+	if (module_initialized)
+	{
+		log("sdliv::DirectoryWatcher::init() called while already initialized");
+		return -1;
+	}
+
+#ifndef WIN32
+	event_type = SDL_RegisterEvents(1);
+	if (event_type == (Uint32) -1)
+	{
+		log("sdliv::DirectoryWatcher::init() -- SDL_RegisterEvents() failed");
+		return -1;
+	}
+
+	module_initialized = true;
+	return 0;
+#else
+	log("sdliv::DirectoryWatcher::init() -- not supported on this platform");
+	return -1;
+#endif
+}
+
+
+
+
+
+int sdliv::DirectoryWatcher::quit()
+{
+	if (!module_initialized)
+	{
+		log("sdliv::DirectoryWatcher::quit() called while module uninitialized");
+		return -1;
+	}
+
+	stop();
+
+	//free paths that were posted but never consumed
+	SDL_Event e;
+	while (SDL_PeepEvents(&e, 1, SDL_GETEVENT, event_type, event_type) > 0)
+	{
+		delete (std::string*) e.user.data1;
+	}
+
+	module_initialized = false;
+	return 0;
+}
+
+
+
+
+
+int sdliv::DirectoryWatcher::watch(const std::filesystem::path & dir)
+{
+	if (!module_initialized) return -1;
+
+	if (isWatching())
+	{
+		if (dir == watched_directory && !watch_lost) return 0;
+		stop();
+	}
+
+#ifndef WIN32
+	inotify_fd = inotify_init1(IN_CLOEXEC);
+	if (inotify_fd < 0)
+	{
+		log("sdliv::DirectoryWatcher::watch() -- inotify_init1() failed");
+		return -1;
+	}
+
+	Uint32 mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF;
+	watch_descriptor = inotify_add_watch(inotify_fd, dir.string().c_str(), mask);
+	if (watch_descriptor < 0)
+	{
+		log("sdliv::DirectoryWatcher::watch() -- inotify_add_watch() failed", dir.string());
+		::close(inotify_fd);
+		inotify_fd = -1;
+		return -1;
+	}
+
+	if (pipe2(wake_pipe, O_CLOEXEC))
+	{
+		log("sdliv::DirectoryWatcher::watch() -- pipe2() failed");
+		::close(inotify_fd);
+		inotify_fd = -1;
+		watch_descriptor = -1;
+		return -1;
+	}
+
+	watched_directory = dir;
+	watch_lost = false;
+	watcher = std::thread(work);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+
+
+
+
+int sdliv::DirectoryWatcher::stop()
+{
+	if (!isWatching()) return -1;
+
+#ifndef WIN32
+	char c = 0;
+	if (write(wake_pipe[1], &c, 1) != 1)
+	{
+		log("sdliv::DirectoryWatcher::stop() -- failed to wake watcher thread");
+	}
+
+	watcher.join();
+
+	::close(wake_pipe[0]);
+	::close(wake_pipe[1]);
+	wake_pipe[0] = wake_pipe[1] = -1;
+
+	//closing the inotify instance drops the watch with it
+	::close(inotify_fd);
+	inotify_fd = -1;
+	watch_descriptor = -1;
+#endif
+
+	watched_directory = std::filesystem::path();
+	return 0;
+}
+
+
+
+
+
+bool sdliv::DirectoryWatcher::isInit()
+{
+	return module_initialized;
+}
+
+
+
+
+
+bool sdliv::DirectoryWatcher::isWatching()
+{
+	return watcher.joinable();
+}
+
+
+
+
+
+Uint32 sdliv::DirectoryWatcher::getEventType()
+{
+	return event_type;
+}
+
+
+
+
+
+int sdliv::DirectoryWatcher::post(Change change, const std::string & path)
+{
+	SDL_Event e;
+	SDL_zero(e);
+	e.type = event_type;
+	e.user.code = change;
+	e.user.data1 = new std::string(path);
+
+	if (SDL_PushEvent(&e) != 1)
+	{
+		log("sdliv::DirectoryWatcher::post() -- SDL_PushEvent() failed", SDL_GetError());
+		delete (std::string*) e.user.data1;
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+
+
+void sdliv::DirectoryWatcher::work()
+{
+	perf::setThreadName("DirectoryWatcher");
+
+#ifndef WIN32
+	//inotify_event is variable length, keep the buffer aligned for it
+	alignas(struct inotify_event) char buffer[16 * 1024];
+
+	struct pollfd fds[2];
+	fds[0].fd = inotify_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = wake_pipe[0];
+	fds[1].events = POLLIN;
+
+	while (true)
+	{
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR) continue;
+			log("sdliv::DirectoryWatcher::work() -- poll() failed");
+			return;
+		}
+
+		if (fds[1].revents != 0) return;
+		if ((fds[0].revents & POLLIN) == 0) continue;
+
+		ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+		if (length <= 0) continue;
+
+		for (char * p = buffer; p < buffer + length; )
+		{
+			struct inotify_event * event = (struct inotify_event*) p;
+			p += sizeof(struct inotify_event) + event->len;
+
+			//the rescan calls watch() again, which replaces a dropped watch
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) watch_lost = true;
+
+			if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				post(WATCH_RESCAN, std::string());
+				continue;
+			}
+
+			if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+
+			std::string path = (watched_directory / event->name).string();
+
+			if (event->mask & IN_CLOSE_WRITE)                    post(WATCH_MODIFIED, path);
+			else if (event->mask & IN_MOVED_TO)                  post(WATCH_ADDED, path);
+			else if (event->mask & (IN_DELETE | IN_MOVED_FROM))  post(WATCH_REMOVED, path);
+		}
+	}
+#endif
+}
@@ -30,6 +30,8 @@ sdliv::Element::Element()
 
 	width = 0;
 	height = 0;
+	decoded_width = 0;
+	decoded_height = 0;
 
 	scale = 1.0;
 	scale_x = 1.0;
@@ -41,6 +43,9 @@ sdliv::Element::Element()
 	surface = nullptr;
 	renderer = nullptr;
 	texture = nullptr;
+	texture_pool = nullptr;
+	texture_pooled = false;
+	scaled_bytes = 0;
 }
 
 
@@ -60,6 +65,8 @@ sdliv::Element::Element(const Element & e)
 
 	width = e.width;
 	height = e.height;
+	decoded_width = e.decoded_width;
+	decoded_height = e.decoded_height;
 
 	scale = e.scale;
 	scale_x = e.scale_x;
@@ -78,6 +85,11 @@ sdliv::Element::Element(const Element & e)
 	surface = e.surface;
 	renderer = e.renderer;
 	texture = e.texture;
+	texture_pool = e.texture_pool;
+	texture_pooled = e.texture_pooled;
+	scaled = e.scaled;
+	scaled_bytes = e.scaled_bytes;
+	source_path = e.source_path;
 }
 
 
@@ -108,12 +120,13 @@ int sdliv::Element::close()
 
 	if (texture != nullptr)
 	{
-		SDL_DestroyTexture(texture);
-		texture = nullptr;
+		freeTexture();
 		hidden = true;
 		error = 0;
 	}
 
+	freeScaled();
+
 	if (surface != nullptr)
 	{
 		SDL_FreeSurface(surface);
@@ -148,33 +161,219 @@ SDL_Renderer * sdliv::Element::getRenderingContext()
 
 
 
+int sdliv::Element::setTexturePool(TexturePool * p)
+{
+	texture_pool = p;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Element::freeTexture()
+{
+	if (texture == nullptr) return -1;
+
+	if (texture_pooled) texture_pool->release(texture);
+	else SDL_DestroyTexture(texture);
+
+	texture = nullptr;
+	texture_pooled = false;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Element::uploadSurface()
+{
+	SDL_assert(surface != nullptr);
+
+	freeTexture();
+
+	texture = textureFrom(&surface, &texture_pooled);
+	return (texture == nullptr) ? -1 : 0;
+}
+
+
+
+
+
+SDL_Texture * sdliv::Element::textureFrom(SDL_Surface ** s, bool * pooled)
+{
+	SDL_assert(s != nullptr && *s != nullptr && pooled != nullptr);
+
+	*pooled = false;
+
+	if (texture_pool == nullptr)
+	{
+		perf::ScopedTimer timer(perf::STAGE_UPLOAD);
+
+		SDL_Texture * t = SDL_CreateTextureFromSurface(renderer, *s);
+		if (t == nullptr)
+		{
+			log("sdliv::Element::textureFrom() -- SDL_CreateTextureFromSurface() failed", SDL_GetError());
+		}
+		else perf::add(perf::COUNTER_BYTES_UPLOADED, (std::uint64_t) (*s)->pitch * (*s)->h);
+
+		return t;
+	}
+
+	//pooled textures are all one format so any image can reuse them
+	//surfaces from the Loader are in it already, this is a no-op for them
+	const Uint32 format = texture_pool->getFormat();
+	*s = Decoder::convert(*s, format);
+	if ((*s)->format->format != format) return nullptr;
+
+	perf::ScopedTimer timer(perf::STAGE_UPLOAD);
+
+	SDL_Texture * t = texture_pool->acquire((*s)->w, (*s)->h, format);
+	if (t == nullptr) return nullptr;
+
+	if (TexturePool::upload(t, *s))
+	{
+		texture_pool->release(t);
+		return nullptr;
+	}
+	perf::add(perf::COUNTER_BYTES_UPLOADED, (std::uint64_t) (*s)->pitch * (*s)->h);
+
+	*pooled = true;
+	return t;
+}
+
+
+
+
+
+int sdliv::Element::freeScaled(bool lost)
+{
+	for (Scaled & version : scaled)
+	{
+		if (version.pooled && !lost) texture_pool->release(version.texture);
+		else SDL_DestroyTexture(version.texture);
+	}
+
+	scaled.clear();
+	scaled_bytes = 0;
+
+	return 0;
+}
+
+
+
+
+
+SDL_Texture * sdliv::Element::findScaled() const
+{
+	if (scaled.empty()) return nullptr;
+
+	//zoomed in or panned, only the full texture has those pixels
+	if (src_rect.x != 0 || src_rect.y != 0 || src_rect.w != width || src_rect.h != height) return nullptr;
+
+	for (const Scaled & version : scaled)
+	{
+		if (version.width == dst_rect.w && version.height == dst_rect.h) return version.texture;
+	}
+
+	return nullptr;
+}
+
+
+
+
+
+int sdliv::Element::addScaled(SDL_Surface * s)
+{
+	if (s == nullptr)
+	{
+		log("sdliv::Element::addScaled() -- passed null parameter");
+		return -1;
+	}
+
+	if (is_copy || renderer == nullptr || hasScaled(s->w, s->h))
+	{
+		SDL_FreeSurface(s);
+		return -1;
+	}
+
+	Scaled version;
+	version.width = s->w;
+	version.height = s->h;
+	version.texture = textureFrom(&s, &version.pooled);
+	version.bytes = (size_t) s->pitch * s->h;
+	SDL_FreeSurface(s);
+
+	if (version.texture == nullptr) return -1;
+
+	scaled.push_front(version);
+	scaled_bytes += version.bytes;
+
+	//window resizes would otherwise pile up a copy per size
+	while ((int) scaled.size() > constants::scaled_versions)
+	{
+		Scaled & oldest = scaled.back();
+		if (oldest.pooled) texture_pool->release(oldest.texture);
+		else SDL_DestroyTexture(oldest.texture);
+
+		scaled_bytes -= oldest.bytes;
+		scaled.pop_back();
+	}
+
+	return 0;
+}
+
+
+
+
+
+bool sdliv::Element::hasScaled(int w, int h) const
+{
+	for (const Scaled & version : scaled)
+	{
+		if (version.width == w && version.height == h) return true;
+	}
+
+	return false;
+}
+
+
+
+
+
 int sdliv::Element::createFromSurface(SDL_Surface * s)
 {
+	perf::ScopedTimer timer(perf::STAGE_CREATE);
+
 	if (s == nullptr)
 	{
 		log("sdliv::Element::createFromSurface() -- passed null parameter");
 		return -1;
 	}
 
+	//the upload may swap surface for a converted copy and free s
+	int w = s->w, h = s->h;
+
 	surface = s;
 	if (renderer != nullptr)
 	{
-		if (texture != nullptr) {
-			SDL_DestroyTexture(texture);
-		}
-		texture = SDL_CreateTextureFromSurface(renderer,surface);
-		if (texture == nullptr)
+		if (uploadSurface())
 		{
-			log("sdliv::Element::createFromSurface() -- SDL_CreateTextureFromSurface() failed");
+			log("sdliv::Element::createFromSurface() -- failed to upload surface");
 			close();
 			return -1;
 		}
 
 		hidden = false;
-		width = s->w; height = s->h;
+		width = w; height = h;
+		decoded_width = w; decoded_height = h;
 		xpos = ypos = zpos = 0;
 		src_rect.x = 0; src_rect.y = 0; src_rect.w = width; src_rect.h = height;
 		dst_rect.x = 0; dst_rect.y = 0; dst_rect.w = width; dst_rect.h = height;
+
+		//the texture has the pixels now, don't hold them twice
+		releaseSurface();
 	}
 
 	else
@@ -204,6 +403,7 @@ int sdliv::Element::createFromImage(const char * path)
 		close();
 	}
 
+	source_path = path;
 	surface = IMG_Load(path);
 	if (surface == nullptr)
 	{
@@ -264,6 +464,285 @@ int sdliv::Element::createFromText(Font * font, const std::string & txt)
 
 
 
+int sdliv::Element::createFromDecoder(const std::string & path, int target_width, int target_height)
+{
+	if (is_copy)
+	{
+		log("sdliv::Element::createFromDecoder() called from copy");
+		return -1;
+	}
+
+	if (renderer == nullptr)
+	{
+		log("sdliv::Element::createFromDecoder() called with no rendering context");
+		return -1;
+	}
+
+	if (texture != nullptr || surface != nullptr)
+	{
+		log("sdliv::Element::createFromDecoder() called with unclosed texture");
+		close();
+	}
+
+	//the pool's format, the renderer takes it without converting
+	Uint32 format = (texture_pool != nullptr) ? texture_pool->getFormat() : (Uint32) SDL_PIXELFORMAT_ARGB8888;
+	if (!Decoder::canDecodeInto(format)) format = SDL_PIXELFORMAT_ARGB8888;
+
+	SDL_RendererInfo info;
+	if (SDL_GetRendererInfo(renderer, &info)) info.max_texture_width = info.max_texture_height = 0;
+
+	SDL_Texture * t = nullptr;
+	bool locked = false;
+
+	auto sink = [&](int w, int h, int * pitch) -> void*
+	{
+		//too big for one texture, that's a TiledElement's job
+		if ((info.max_texture_width > 0 && w > info.max_texture_width)
+				|| (info.max_texture_height > 0 && h > info.max_texture_height))
+		{
+			return nullptr;
+		}
+
+		if (texture_pool != nullptr) t = texture_pool->acquire(w, h, format);
+		else
+		{
+			t = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, w, h);
+			if (t != nullptr) SDL_SetTextureBlendMode(t, SDL_BLENDMODE_BLEND);
+		}
+		if (t == nullptr) return nullptr;
+
+		void * pixels = nullptr;
+		if (SDL_LockTexture(t, nullptr, &pixels, pitch))
+		{
+			log("sdliv::Element::createFromDecoder() -- SDL_LockTexture() failed", SDL_GetError());
+			return nullptr;
+		}
+
+		locked = true;
+		return pixels;
+	};
+
+	int full_w = 0, full_h = 0;
+	int error = Decoder::decodeInto(path, target_width, target_height, format, sink, &full_w, &full_h);
+
+	if (locked) SDL_UnlockTexture(t);
+
+	if (error)
+	{
+		if (t != nullptr && texture_pool != nullptr) texture_pool->release(t);
+		else if (t != nullptr) SDL_DestroyTexture(t);
+		return -1;
+	}
+
+	int w = 0, h = 0;
+	SDL_QueryTexture(t, nullptr, nullptr, &w, &h);
+
+	//decoded straight into the texture, those bytes count as uploaded too
+	perf::add(perf::COUNTER_BYTES_UPLOADED, (std::uint64_t) w * h * SDL_BYTESPERPIXEL(format));
+
+	texture = t;
+	texture_pooled = (texture_pool != nullptr);
+	source_path = path;
+
+	hidden = false;
+	width = full_w; height = full_h;
+	decoded_width = w; decoded_height = h;
+	xpos = ypos = 0;
+	src_rect.x = 0; src_rect.y = 0; src_rect.w = width; src_rect.h = height;
+	dst_rect.x = 0; dst_rect.y = 0; dst_rect.w = width; dst_rect.h = height;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::Element::setSource(const std::string & path)
+{
+	source_path = path;
+	return 0;
+}
+
+
+
+
+
+const std::string & sdliv::Element::getSource() const
+{
+	return source_path;
+}
+
+
+
+
+
+SDL_Surface * sdliv::Element::getSurface()
+{
+	if (surface != nullptr) return surface;
+	if (source_path.empty()) return nullptr;
+
+	//the same reduction as before, so the texture and surface agree
+	int target_width = isReduced() ? decoded_width : 0;
+	int target_height = isReduced() ? decoded_height : 0;
+	int full_width = 0, full_height = 0;
+
+	surface = Decoder::decode(source_path, target_width, target_height, &full_width, &full_height);
+	if (surface == nullptr)
+	{
+		log("sdliv::Element::getSurface() -- failed to decode", source_path);
+		return nullptr;
+	}
+
+	//rounding in the scaled decode can land a pixel off
+	decoded_width = surface->w;
+	decoded_height = surface->h;
+
+	return surface;
+}
+
+
+
+
+
+int sdliv::Element::releaseSurface()
+{
+	if (surface == nullptr) return 0;
+	if (source_path.empty() || texture == nullptr) return -1;
+
+	SDL_FreeSurface(surface);
+	surface = nullptr;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Element::restoreTexture()
+{
+	if (is_copy)
+	{
+		log("sdliv::Element::restoreTexture() called from copy");
+		return -1;
+	}
+
+	//made again on request, the App asks for them whenever it draws
+	freeScaled(true);
+
+	if (texture == nullptr) return 0;
+
+	Uint32 format = 0;
+	int access = 0, w = 0, h = 0;
+	if (SDL_QueryTexture(texture, &format, &access, &w, &h))
+	{
+		log("sdliv::Element::restoreTexture() -- SDL_QueryTexture() failed", SDL_GetError());
+		return -1;
+	}
+
+	//lost with the device, it can't go back to the pool
+	const bool pooled = texture_pooled;
+	SDL_DestroyTexture(texture);
+	texture = nullptr;
+	texture_pooled = false;
+
+	if (access == SDL_TEXTUREACCESS_STREAMING && !pooled)
+	{
+		texture = SDL_CreateTexture(renderer, format, access, w, h);
+		if (texture == nullptr)
+		{
+			log("sdliv::Element::restoreTexture() -- SDL_CreateTexture() failed", SDL_GetError());
+			hidden = true;
+			return -1;
+		}
+
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		return 0;
+	}
+
+	if (getSurface() == nullptr || uploadSurface())
+	{
+		log("sdliv::Element::restoreTexture() -- failed to upload surface");
+		hidden = true;
+		return -1;
+	}
+
+	releaseSurface();
+	return 0;
+}
+
+
+
+
+
+int sdliv::Element::createStreaming(int w, int h, Uint32 format)
+{
+	if (is_copy)
+	{
+		log("sdliv::Element::createStreaming() called from copy");
+		return -1;
+	}
+
+	if (renderer == nullptr)
+	{
+		log("sdliv::Element::createStreaming() called with no rendering context");
+		return -1;
+	}
+
+	if (texture != nullptr || surface != nullptr)
+	{
+		log("sdliv::Element::createStreaming() called with unclosed texture");
+		close();
+	}
+
+	texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, w, h);
+	if (texture == nullptr)
+	{
+		log("sdliv::Element::createStreaming() -- SDL_CreateTexture() failed", SDL_GetError());
+		return -1;
+	}
+
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+	hidden = false;
+	width = w; height = h;
+	decoded_width = w; decoded_height = h;
+	src_rect.x = 0; src_rect.y = 0; src_rect.w = width; src_rect.h = height;
+	dst_rect.x = 0; dst_rect.y = 0; dst_rect.w = width; dst_rect.h = height;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::Element::updateTexture(const void * pixels, int pitch, int w, int h)
+{
+	if (texture == nullptr || pixels == nullptr)
+	{
+		log("sdliv::Element::updateTexture() called with null texture or pixels");
+		return -1;
+	}
+
+	SDL_Rect r = { 0, 0, w, h };
+	if (SDL_UpdateTexture(texture, &r, pixels, pitch))
+	{
+		log("sdliv::Element::updateTexture() -- SDL_UpdateTexture() failed", SDL_GetError());
+		return -1;
+	}
+
+	width = w; height = h;
+	decoded_width = w; decoded_height = h;
+	src_rect = r;
+
+	return 0;
+}
+
+
+
+
+
 int sdliv::Element::getID() const
 {
 	return ID;
@@ -291,6 +770,52 @@ int sdliv::Element::getHeight() const
 
 
 
+int sdliv::Element::setLogicalSize(int w, int h)
+{
+	if (w <= 0 || h <= 0)
+	{
+		log("sdliv::Element::setLogicalSize() called with negative params");
+		return -1;
+	}
+
+	width = w; height = h;
+	src_rect.x = 0; src_rect.y = 0; src_rect.w = width; src_rect.h = height;
+	dst_rect.w = width; dst_rect.h = height;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::Element::getDecodedWidth() const
+{
+	return decoded_width;
+}
+
+
+
+
+
+int sdliv::Element::getDecodedHeight() const
+{
+	return decoded_height;
+}
+
+
+
+
+
+bool sdliv::Element::isReduced() const
+{
+	return decoded_width < width || decoded_height < height;
+}
+
+
+
+
+
 int sdliv::Element::getLayer() const
 {
 	return zpos;
@@ -300,6 +825,36 @@ int sdliv::Element::getLayer() const
 
 
 
+size_t sdliv::Element::getSurfaceBytes() const
+{
+	if (surface == nullptr) return 0;
+
+	return (size_t) surface->pitch * surface->h;
+}
+
+
+
+
+
+size_t sdliv::Element::getTextureBytes() const
+{
+	if (texture == nullptr) return scaled_bytes;
+
+	Uint32 format = 0;
+	int w = 0, h = 0;
+	if (SDL_QueryTexture(texture, &format, nullptr, &w, &h))
+	{
+		log("sdliv::Element::getTextureBytes() -- SDL_QueryTexture() failed");
+		return 0;
+	}
+
+	return (size_t) w * h * SDL_BYTESPERPIXEL(format) + scaled_bytes;
+}
+
+
+
+
+
 double sdliv::Element::getDrawScale() const
 {
 	return scale;
@@ -416,6 +971,48 @@ int sdliv::Element::setDrawScale(double s)
 
 
 
+int sdliv::Element::setSourceRect(const SDL_Rect & r)
+{
+	int x0 = std::max(0, std::min(r.x, width));
+	int y0 = std::max(0, std::min(r.y, height));
+	int x1 = std::max(x0, std::min(r.x + r.w, width));
+	int y1 = std::max(y0, std::min(r.y + r.h, height));
+
+	src_rect.x = x0; src_rect.y = y0; src_rect.w = x1 - x0; src_rect.h = y1 - y0;
+	return 0;
+}
+
+
+
+
+
+SDL_Rect sdliv::Element::getSourceRect() const
+{
+	return src_rect;
+}
+
+
+
+
+
+int sdliv::Element::setDrawRect(const SDL_Rect & r)
+{
+	dst_rect = r;
+
+	if (src_rect.w > 0 && src_rect.h > 0)
+	{
+		scale_x = ((double) r.w) / src_rect.w;
+		scale_y = ((double) r.h) / src_rect.h;
+		scale = scale_x < scale_y ? scale_x : scale_y;
+	}
+
+	return 0;
+}
+
+
+
+
+
 int sdliv::Element::show()
 {
 	if (!hidden) return -1;
@@ -457,5 +1054,17 @@ int sdliv::Element::draw()
 		return -1;
 	}
 
-	return SDL_RenderCopy(renderer,texture,&src_rect,&dst_rect);
+	SDL_Texture * t = findScaled();
+	if (t != nullptr) return SDL_RenderCopy(renderer, t, nullptr, &dst_rect);
+
+	if (!isReduced()) return SDL_RenderCopy(renderer,texture,&src_rect,&dst_rect);
+
+	//src_rect is in full size pixels, the texture is smaller
+	SDL_Rect r;
+	r.x = (int) ((long) src_rect.x * decoded_width / width);
+	r.y = (int) ((long) src_rect.y * decoded_height / height);
+	r.w = (int) (((long) (src_rect.x + src_rect.w) * decoded_width + width - 1) / width) - r.x;
+	r.h = (int) (((long) (src_rect.y + src_rect.h) * decoded_height + height - 1) / height) - r.y;
+
+	return SDL_RenderCopy(renderer,texture,&r,&dst_rect);
 }
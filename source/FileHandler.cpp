@@ -1,5 +1,14 @@
 #include <sdliv.h>
 
+#include <iterator>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
 std::set<std::string> sdliv::FileHandler::supportedExtensions = {
 /* added dynamically dependent upon success of Img_Init
 	".jpg",
@@ -31,31 +40,70 @@ bool sdliv::FileHandler::hasValidExtension(const std::filesystem::directory_entr
 //static members
 bool sdliv::FileHandler::setComparison(const sdliv::FileHandler *lhs, const sdliv::FileHandler *rhs)
 {
-	return lhs->fs_entry.path() < rhs->fs_entry.path();
+	switch (sort_order)
+	{
+		case SORT_MTIME:
+			if (lhs->mtime != rhs->mtime) return lhs->mtime < rhs->mtime;
+			break;
+		case SORT_SIZE:
+			if (lhs->file_size != rhs->file_size) return lhs->file_size < rhs->file_size;
+			break;
+		case SORT_EXTENSION:
+		{
+			int c = util::naturalCompare(lhs->sortExtension(), rhs->sortExtension());
+			if (c != 0) return c < 0;
+			break;
+		}
+		default:
+			break;
+	}
+
+	int c = util::naturalCompare(lhs->sortName(), rhs->sortName());
+	if (c != 0) return c < 0;
+
+	//IMG_01 and IMG_1 tie, fall back to the raw path for a total order
+	return lhs->relative_path < rhs->relative_path;
 }
-std::set<sdliv::FileHandler*, decltype(sdliv::FileHandler::setComparison)*> sdliv::FileHandler::tracked_files(sdliv::FileHandler::setComparison);
+sdliv::SortOrder sdliv::FileHandler::sort_order = sdliv::SORT_NAME;
+std::vector<sdliv::FileHandler*> sdliv::FileHandler::tracked_files = std::vector<sdliv::FileHandler*>();
+std::unordered_map<sdliv::FileHandler::PathView, sdliv::FileHandler*> sdliv::FileHandler::tracked_paths
+		= std::unordered_map<sdliv::FileHandler::PathView, sdliv::FileHandler*>();
 
 sdliv::FileHandler * sdliv::FileHandler::active_image = nullptr;
+size_t sdliv::FileHandler::active_index = 0;
+const sdliv::FileHandler * sdliv::FileHandler::lookup_counted = nullptr;
 
 std::filesystem::directory_entry sdliv::FileHandler::workingDirectory = std::filesystem::directory_entry();
 
+int sdliv::FileHandler::ID_count = 0;
+std::map<int, sdliv::FileHandler*> sdliv::FileHandler::handlers = std::map<int, sdliv::FileHandler*>();
+
+int sdliv::FileHandler::prefetch_radius = sdliv::constants::prefetch_radius;
+
+bool sdliv::FileHandler::lazy_detection = true;
+bool sdliv::FileHandler::recursive_scan = false;
+bool sdliv::FileHandler::reduced_decode = true;
+int sdliv::FileHandler::recursive_max_depth = -1;
+bool sdliv::FileHandler::rescanning = false;
+
 
 
 //static methods
-sdliv::FileHandler* sdliv::FileHandler::openFileIfSupported(const std::filesystem::directory_entry & dirEnt)
+sdliv::FileHandler* sdliv::FileHandler::openFileIfSupported(const std::filesystem::directory_entry & dirEnt, bool detect)
 {
-	if (active_image != nullptr && active_image->fs_entry == dirEnt)
+	if (active_image != nullptr && active_image->relative_path == relativePath(dirEnt.path()))
 	{
 		return active_image;
 	}
 
 	if (!hasValidExtension(dirEnt))
 	{
-		log("sdliv::FileHandler::openFileIfSupported() -- file extension not supported:", dirEnt.path().filename().string());
+		log_debug("sdliv::FileHandler::openFileIfSupported() -- file extension not supported:", dirEnt.path().filename().string());
 		return nullptr;
 	}
 
-	FileHandler * fh = new FileHandler(dirEnt);
+	//don't touch the file until we know it isn't tracked already
+	FileHandler * fh = new FileHandler(dirEnt, false);
 
 	if (fh == nullptr)
 	{
@@ -63,22 +111,22 @@ sdliv::FileHandler* sdliv::FileHandler::openFileIfSupported(const std::filesyste
 		return nullptr;
 	}
 
-	if (fh->type == FILETYPE_UNSUPPORTED)
+	FileHandler * tracked = findTracked(dirEnt.path());
+	if (tracked != nullptr)
 	{
-		log("sdliv::FileHandler::openFileIfSupported() -- unsupported file", dirEnt.path().filename().string());
 		delete fh;
-		return nullptr;
+		return tracked;
 	}
 
-	if (tracked_files.count(fh) > 0)
-	{
-		log("sdliv::FileHandler::openFileIfSupported() -- file already tracked", fh->getPathAsString());
-	}
-	else
+	if (detect && fh->detectImageType() == FILETYPE_UNSUPPORTED)
 	{
-		track(fh);
+		log_debug("sdliv::FileHandler::openFileIfSupported() -- unsupported file", dirEnt.path().filename().string());
+		delete fh;
+		return nullptr;
 	}
 
+	track(fh);
+
 	return fh;
 }
 
@@ -106,13 +154,27 @@ int sdliv::FileHandler::track(sdliv::FileHandler * fh)
 {
 	SDL_assert(fh != nullptr);
 
-	if (tracked_files.find(fh) != tracked_files.end())
+	if (tracked_paths.count(fh->relative_path) > 0)
 	{
 		log("sdliv::FileHandler::track() -- file already tracked", fh->getPathAsString());
 		return -1;
 	}
 
-	tracked_files.insert(fh);
+	//every tracked file needs the keys the current order compares
+	if ((sort_order == SORT_MTIME || sort_order == SORT_SIZE) && !fh->key_valid)
+	{
+		fh->refreshKey();
+	}
+
+	auto iter = std::lower_bound(tracked_files.begin(), tracked_files.end(), fh, setComparison);
+
+	size_t index = iter - tracked_files.begin();
+	tracked_files.insert(iter, fh);
+	tracked_paths[fh->relative_path] = fh;
+
+	//keep active_index pointing at the same file
+	if (active_image != nullptr && index <= active_index) active_index++;
+
 	return 0;
 }
 
@@ -120,15 +182,105 @@ int sdliv::FileHandler::track(sdliv::FileHandler * fh)
 
 
 
-std::set<sdliv::FileHandler*>::iterator sdliv::FileHandler::untrack(std::set<sdliv::FileHandler*>::iterator fhIter)
+size_t sdliv::FileHandler::untrack(size_t index)
 {
-	FileHandler* fh = *fhIter;
-	std::set<FileHandler*>::iterator iter = tracked_files.erase(fhIter);
+	SDL_assert(index < tracked_files.size());
+
+	FileHandler* fh = tracked_files[index];
+	tracked_files.erase(tracked_files.begin() + index);
+	tracked_paths.erase(fh->relative_path);
+
+	if (fh == active_image)
+	{
+		//the caller decides what becomes active, index now holds the next file
+		active_image = nullptr;
+	}
+	else if (active_image != nullptr && index < active_index)
+	{
+		active_index--;
+	}
 
 	if (fh != nullptr) delete fh;
 	fh = nullptr;
 
-	return iter;
+	return index;
+}
+
+
+
+
+
+int sdliv::FileHandler::reposition(size_t index)
+{
+	SDL_assert(index < tracked_files.size());
+
+	FileHandler * fh = tracked_files[index];
+	tracked_files.erase(tracked_files.begin() + index);
+
+	auto iter = std::lower_bound(tracked_files.begin(), tracked_files.end(), fh, setComparison);
+	size_t new_index = iter - tracked_files.begin();
+	tracked_files.insert(iter, fh);
+
+	if (fh == active_image)
+	{
+		active_index = new_index;
+	}
+	else if (active_image != nullptr)
+	{
+		if (index < active_index) active_index--;
+		if (new_index <= active_index) active_index++;
+	}
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::FileHandler::trackBatch(std::vector<FileHandler*> & batch)
+{
+	if (sort_order == SORT_MTIME || sort_order == SORT_SIZE)
+	{
+		for (FileHandler * fh : batch)
+		{
+			if (!fh->key_valid) fh->refreshKey();
+		}
+	}
+
+	std::sort(batch.begin(), batch.end(), setComparison);
+
+	for (FileHandler * fh : batch)
+	{
+		tracked_paths[fh->relative_path] = fh;
+	}
+
+	//one linear merge instead of an insert, and a memmove, per file
+	std::vector<FileHandler*> merged;
+	merged.reserve(tracked_files.size() + batch.size());
+	std::merge(tracked_files.begin(), tracked_files.end(), batch.begin(), batch.end(),
+			std::back_inserter(merged), setComparison);
+	tracked_files.swap(merged);
+
+	if (active_image != nullptr)
+	{
+		active_index = indexOf(active_image);
+		SDL_assert(active_index != npos);
+	}
+
+	return (int) batch.size();
+}
+
+
+
+
+
+size_t sdliv::FileHandler::indexOf(const FileHandler * fh)
+{
+	auto iter = std::lower_bound(tracked_files.begin(), tracked_files.end(), fh, setComparison);
+	if (iter == tracked_files.end() || *iter != fh) return npos;
+
+	return iter - tracked_files.begin();
 }
 
 
@@ -143,6 +295,10 @@ int sdliv::FileHandler::untrackAll()
 	}
 
 	tracked_files.clear();
+	tracked_paths.clear();
+	active_image = nullptr;
+	active_index = 0;
+	rescanning = false;
 
 	return 0;
 }
@@ -151,7 +307,7 @@ int sdliv::FileHandler::untrackAll()
 
 std::string sdliv::FileHandler::getPathAsString() const
 {
-	return this->fs_entry.path().string();
+	return getPath().string();
 }
 
 
@@ -162,6 +318,21 @@ void sdliv::FileHandler::addSupport(const std::string &extension)
 }
 
 
+
+void sdliv::FileHandler::setLazyDetection(bool lazy)
+{
+	lazy_detection = lazy;
+}
+
+
+
+void sdliv::FileHandler::setRecursive(bool recursive, int max_depth)
+{
+	recursive_scan = recursive;
+	recursive_max_depth = max_depth;
+}
+
+
 std::filesystem::directory_entry sdliv::FileHandler::getWorkingDirectory()
 {
 	return workingDirectory;
@@ -174,10 +345,55 @@ int sdliv::FileHandler::setWorkingDirectory(std::filesystem::path path)
 		log("sdliv::FileHandler::setWorkingDirectory() -- directory does not exist:", path.string());
 		return -1;
 	}
+
+	//each tracked file's relative_path has to be below the new directory
+	std::vector<std::filesystem::path> full;
+	full.reserve(tracked_files.size());
+	for (FileHandler * fh : tracked_files) full.push_back(fh->getPath());
+
 	workingDirectory = std::filesystem::directory_entry(path);
+
+	tracked_paths.clear();
+	for (size_t i = 0; i < tracked_files.size(); i++)
+	{
+		tracked_files[i]->relative_path = relativePath(full[i]);
+		tracked_paths[tracked_files[i]->relative_path] = tracked_files[i];
+	}
+
+	//names below the directory are what a recursive scan sorts by
+	std::sort(tracked_files.begin(), tracked_files.end(), setComparison);
+	if (active_image != nullptr) active_index = indexOf(active_image);
+
 	return 0;
 }
 
+
+
+std::string sdliv::FileHandler::relativePath(const std::filesystem::path & p)
+{
+	std::string full = p.string();
+	std::string root = workingDirectory.path().string();
+
+	if (!root.empty() && full.size() > root.size() && full.compare(0, root.size(), root) == 0)
+	{
+		char c = full[root.size()];
+		if (c == '/' || c == (char) std::filesystem::path::preferred_separator) return full.substr(root.size() + 1);
+
+		c = root.back();
+		if (c == '/' || c == (char) std::filesystem::path::preferred_separator) return full.substr(root.size());
+	}
+
+	//a relative path that isn't below it would be joined to the wrong directory
+	if (!root.empty() && p.is_relative())
+	{
+		std::error_code ec;
+		std::filesystem::path absolute = std::filesystem::absolute(p, ec);
+		if (!ec) return absolute.string();
+	}
+
+	return full;
+}
+
 int sdliv::FileHandler::setWorkingDirectory(std::string dir)
 {
 	std::filesystem::path d = std::filesystem::path(dir);
@@ -189,6 +405,8 @@ int sdliv::FileHandler::setWorkingDirectory(std::string dir)
 
 int sdliv::FileHandler::openDirectory(bool force)
 {
+	perf::ScopedTimer timer(perf::STAGE_SCAN);
+
 	if (!std::filesystem::exists(workingDirectory))
 	{
 		log("sdliv::FileHandler::OpenDirectory() -- invalid directory");
@@ -206,19 +424,85 @@ int sdliv::FileHandler::openDirectory(bool force)
 	int count = 0;
 	if (force)
 	{
+		//start watching first so nothing created during the scan is missed
+		DirectoryWatcher::watch(workingDirectory.path());
+		ThumbnailStore::open(workingDirectory.path());
+
+		//files arrive in batches through onDirectoryScanned()
+		if (DirectoryScanner::scan(workingDirectory.path(), supportedExtensions,
+				recursive_scan, recursive_max_depth) == 0)
+		{
+			return 0;
+		}
+
 		for (auto& f : std::filesystem::directory_iterator(sdliv::FileHandler::workingDirectory))
 		{
 			if (f.is_regular_file())
 			{
-				FileHandler * fh = openFileIfSupported(f);
+				FileHandler * fh = openFileIfSupported(f, !lazy_detection);
 
 				if (fh != nullptr)
 				{
+					fh->listed = true;
 					count++;
 				}
 			}
 		}
+
+		if (rescanning) untrackUnlisted();
+
+		//neighbours of the active image may have just appeared
+		prefetch();
+		requestThumbnails();
+	}
+	return count;
+}
+
+
+
+
+
+int sdliv::FileHandler::rescanDirectory()
+{
+	//files found or tracked from here on are marked again
+	for (FileHandler * fh : tracked_files) fh->listed = false;
+	rescanning = true;
+
+	return openDirectory(true);
+}
+
+
+
+
+
+int sdliv::FileHandler::untrackUnlisted()
+{
+	rescanning = false;
+
+	int count = 0;
+	for (size_t i = 0; i < tracked_files.size(); )
+	{
+		FileHandler * fh = tracked_files[i];
+
+		//update() on the active image moves on if its file is gone
+		if (fh->listed || fh == active_image)
+		{
+			fh->listed = true;
+			i++;
+			continue;
+		}
+
+		ImageCache::invalidate(fh->getPathAsString());
+		i = untrack(i);
+		count++;
 	}
+
+	if (count > 0)
+	{
+		log("sdliv::FileHandler::untrackUnlisted() -- dropped", count, "files deleted while events were lost");
+		updateTitle();
+	}
+
 	return count;
 }
 
@@ -232,7 +516,8 @@ sdliv::Element * sdliv::FileHandler::getActiveImage()
 	{
 		if (!tracked_files.empty())
 		{
-			active_image = *tracked_files.begin();
+			active_index = 0;
+			active_image = tracked_files[0];
 		}
 
 		else
@@ -241,275 +526,1054 @@ sdliv::Element * sdliv::FileHandler::getActiveImage()
 		}
 	}
 
-
-	active_image->update();
-	if (active_image == nullptr)
-	{
-		//**FIXME** we have no valid image, display a placeholder?
-		log("sdliv::FileHandler::getActiveImage() -- no active images available");
-		return nullptr;
-	}
-
-	return active_image->element;
+	return activate(false);
 }
 
 
 
 
 
-sdliv::Element * sdliv::FileHandler::nextImage()
+sdliv::Element * sdliv::FileHandler::jumpToIndex(size_t index)
 {
-	openDirectory(false);
-	if (tracked_files.size() == 0)
+	if (!DirectoryWatcher::isWatching()) openDirectory(false);
+	if (tracked_files.empty())
 	{
-		log("sdliv::FileHandler::nextImage() -- not tracking any files");
+		log("sdliv::FileHandler::jumpToIndex() -- not tracking any files");
 		return nullptr;
 	}
 
-	if (active_image == nullptr)
-	{
-		active_image = *tracked_files.begin();
-		return getActiveImage();
-	}
-
-	auto iter = tracked_files.find(active_image);
-	++iter;
+	if (index >= tracked_files.size()) index = tracked_files.size() - 1;
 
-	if (iter == tracked_files.end())
-	{
-		iter = tracked_files.begin();
-	}
+	active_index = index;
+	active_image = tracked_files[index];
 
-	active_image = *iter;
-
-	return getActiveImage();
+	return activate(true);
 }
 
 
 
 
 
-sdliv::Element * sdliv::FileHandler::prevImage()
+sdliv::Element * sdliv::FileHandler::stepImage(long delta)
 {
-	openDirectory(false);
-	if (tracked_files.size() == 0)
-	{
-		log("sdliv::FileHandler::prevImage() -- not tracking any files");
-		return nullptr;
-	}
+	if (tracked_files.empty()) return jumpToIndex(0);
 
-	if (active_image == nullptr)
-	{
-		active_image = *(--(tracked_files.end()));
-		return getActiveImage();
-	}
+	//clamps at either end, unlike nextImage() and prevImage() which wrap
+	long index = (active_image == nullptr) ? 0 : (long) active_index;
+	index += delta;
+	if (index < 0) index = 0;
+
+	return jumpToIndex((size_t) index);
+}
 
-	auto i = tracked_files.find(active_image);
 
-	if (i == tracked_files.begin())
-	{
-		i = tracked_files.end();
-	}
 
-	active_image = *(--i);
 
-	return getActiveImage();
+
+sdliv::Element * sdliv::FileHandler::firstImage()
+{
+	return jumpToIndex(0);
 }
 
 
 
 
 
-//non-static methods
-sdliv::FileHandler::FileHandler()
+sdliv::Element * sdliv::FileHandler::lastImage()
 {
-	type = FILETYPE_UNSUPPORTED;
-	rwops = nullptr;
-	element = nullptr;
-	window = Window::getFirstWindow();
-	fs_entry = std::filesystem::directory_entry();
+	return jumpToIndex(npos);
 }
 
 
 
 
 
-sdliv::FileHandler::FileHandler(const std::filesystem::directory_entry & file) : sdliv::FileHandler::FileHandler()
+sdliv::Element * sdliv::FileHandler::jumpToFraction(double fraction)
 {
-	setTarget(file);
+	if (fraction < 0.0) fraction = 0.0;
+	if (fraction > 1.0) fraction = 1.0;
+
+	size_t count = tracked_files.size();
+	size_t index = (count == 0) ? 0 : (size_t) (fraction * (count - 1) + 0.5);
+
+	return jumpToIndex(index);
 }
 
 
 
 
-sdliv::FileHandler::FileHandler(const char * filename) : sdliv::FileHandler::FileHandler(std::string(filename))
-{}
+
+size_t sdliv::FileHandler::getActiveIndex()
+{
+	return active_index;
+}
 
 
 
 
 
-sdliv::FileHandler::FileHandler(const std::string & filename) : sdliv::FileHandler::FileHandler(std::filesystem::directory_entry(sdliv::FileHandler::workingDirectory / filename))
-{}
+size_t sdliv::FileHandler::getTrackedCount()
+{
+	return tracked_files.size();
+}
 
 
 
 
 
-sdliv::FileHandler::FileHandler(const sdliv::FileHandler & fh)
+sdliv::FileHandler * sdliv::FileHandler::getTrackedFile(size_t index)
 {
-	// **FIXME** this implementation _will_ cause problems with the destructor
-	log("sdliv::FileHandler::FileHandler(const sdliv::FileHandler&) -- copy constructor called");
-
-	type = fh.type;
-	rwops = fh.rwops;
-	element = fh.element;
-	window = fh.window;
-	fs_entry = fh.fs_entry;
+	return (index < tracked_files.size()) ? tracked_files[index] : nullptr;
 }
 
 
 
 
 
-sdliv::FileHandler::~FileHandler()
+int sdliv::FileHandler::setSortOrder(SortOrder order)
 {
-	//cleanup element
-	if (element != nullptr)
+	if (order < 0 || order >= SORT_COUNT)
 	{
-		if (window != nullptr)
-		{
-			window->removeElement(element);
-		}
+		log("sdliv::FileHandler::setSortOrder() -- invalid order", (int) order);
+		return -1;
+	}
 
-		delete element;
-		element = nullptr;
+	if (order == SORT_MTIME || order == SORT_SIZE)
+	{
+		//one stat per file, spread over threads since it can be NFS
+		util::parallelFor(tracked_files.size(), util::workerCount(tracked_files.size(), 1024),
+			[](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					if (!tracked_files[i]->key_valid) tracked_files[i]->refreshKey();
+				}
+			});
 	}
 
-	//cleanup rwops
-	if (rwops != nullptr) close();
-}
+	sort_order = order;
+	util::parallelSort(tracked_files, setComparison);
 
+	if (active_image != nullptr)
+	{
+		active_index = indexOf(active_image);
+		SDL_assert(active_index != npos);
+	}
 
+	updateTitle();
+	prefetch();
 
-std::filesystem::path sdliv::FileHandler::parent_path() const
-{
-	return fs_entry.path().parent_path();
+	return 0;
 }
 
 
 
-int sdliv::FileHandler::setTarget(const char * fn)
+
+
+sdliv::SortOrder sdliv::FileHandler::getSortOrder()
 {
-	return setTarget(std::string(fn));
+	return sort_order;
 }
 
 
 
 
 
-int sdliv::FileHandler::setTarget(const std::string & fn)
+void sdliv::FileHandler::updateTitle()
 {
-	//filename is _not_ the full path
-	std::filesystem::path p = sdliv::FileHandler::workingDirectory.path() / fn;
-	return setTarget(std::filesystem::directory_entry(p));
-}
+	if (active_image == nullptr) return;
 
+	std::string title = active_image->getPath().filename().string();
+	title += "  [" + std::to_string(active_index + 1) + "/" + std::to_string(tracked_files.size()) + "]";
 
-int sdliv::FileHandler::setTarget(const std::filesystem::directory_entry & file)
-{
-	fs_entry = file;
-	if (!fs_entry.exists() || !fs_entry.is_regular_file())
+	if (DirectoryScanner::isScanning())
 	{
-		log("sdliv::FileHandler:;setTarget() -- file does not exist", file.path().string());
+		title += "  scanning... " + std::to_string(DirectoryScanner::getScannedCount());
 	}
-	type = detectImageType();
-	return 0;
+
+	sdliv::Window::setWindowTitle(title);
 }
 
 
 
 
 
-sdliv::ImageFileType sdliv::FileHandler::detectImageType()
+sdliv::Element * sdliv::FileHandler::activate(bool async)
 {
-	bool close_when_done = false;
-	if (rwops == nullptr)
+	perf::Span span("FileHandler::activate");
+
+	SDL_assert(active_image != nullptr);
+
+	//a count left by a file we've since moved away from
+	if (lookup_counted != active_image) lookup_counted = nullptr;
+
+	if (async && Loader::isInit() && active_image->refreshKey() == 0)
 	{
-		if (open())
+		//hit or miss is counted here, not again by update() now or once
+		//the decode lands
+		lookup_counted = active_image;
+
+		if (ImageCache::get(active_image->getCacheKey()) == nullptr)
 		{
-			type = FILETYPE_UNSUPPORTED;
-			return type;
+			//let the Loader decode it, onImageDecoded() tells the App when it's ready
+			updateTitle();
+			prefetch();
+			return nullptr;
 		}
+	}
 
-		close_when_done = true;
+	active_image->update();
+	if (active_image == nullptr)
+	{
+		//**FIXME** we have no valid image, display a placeholder?
+		log("sdliv::FileHandler::getActiveImage() -- no active images available");
+		return nullptr;
 	}
 
-	if (IMG_isBMP(rwops))  { type = FILETYPE_BMP; }
-	else if (IMG_isJPG(rwops))  { type = FILETYPE_JPG; }
-	else if (IMG_isPNG(rwops))  { type = FILETYPE_PNG; }
-	else if (IMG_isGIF(rwops))  { type = FILETYPE_GIF; }
-	else if (IMG_isWEBP(rwops)) { type = FILETYPE_WEBP; }
-	else if (IMG_isTIF(rwops))  { type = FILETYPE_TIF; }
-	else if (IMG_isSVG(rwops))  { type = FILETYPE_SVG; }
-	else if (IMG_isICO(rwops))  { type = FILETYPE_ICO; }
-	else if (IMG_isCUR(rwops))  { type = FILETYPE_CUR; }
-	else if (IMG_isLBM(rwops))  { type = FILETYPE_LBM; }
-	else if (IMG_isPCX(rwops))  { type = FILETYPE_PCX; }
-	else if (IMG_isPNM(rwops))  { type = FILETYPE_PNM; }
-	else if (IMG_isXCF(rwops))  { type = FILETYPE_XCF; }
-	else if (IMG_isXPM(rwops))  { type = FILETYPE_XPM; }
-	else if (IMG_isXV(rwops))   { type = FILETYPE_XV; }
-	else                        { type = FILETYPE_UNSUPPORTED; }
+	Element * e = active_image->getElement();
+	ImageCache::pin(e);
 
-		if (close_when_done) close();
-	return type;
+	prefetch();
+	return e;
 }
 
 
 
 
 
-int sdliv::FileHandler::update()
+int sdliv::FileHandler::prefetch()
 {
-	std::filesystem::file_time_type timestamp = fs_entry.last_write_time();
-	if (!std::filesystem::exists(fs_entry))
+	perf::Span span("FileHandler::prefetch");
+
+	if (!Loader::isInit() || active_image == nullptr) return -1;
+
+	//whatever is still queued was for the old neighbourhood
+	std::vector<int> cancelled;
+	Loader::cancelAll(&cancelled);
+	for (int id : cancelled)
 	{
-		// **FIXME** this assumes we want the next file, not the previous
-		log("sdliv::FileHandler::update() -- file no longer exists");
-		std::set<FileHandler*>::iterator iter = tracked_files.find(this);
-		iter = untrack(iter);
-		if (iter == tracked_files.end())
-		{
-			if (iter == tracked_files.begin())
+		handlers.erase(id);
+	}
+
+	if (active_image->getElement() == nullptr)
+	{
+		requestDecode(active_image, true);
+	}
+
+	//walk outwards alternating forward and back, nearest files first
+	size_t count_tracked = tracked_files.size();
+	int count = 0;
+	for (int i = 1; i <= prefetch_radius && (size_t) i < count_tracked; i++)
+	{
+		size_t fwd = (active_index + i) % count_tracked;
+		size_t bwd = (active_index + count_tracked - (i % count_tracked)) % count_tracked;
+
+		for (FileHandler * fh : { tracked_files[fwd], tracked_files[bwd] })
+		{
+			if (fh == active_image) continue;
+			if (!fh->key_valid && fh->refreshKey()) continue;
+			if (fh->getElement() != nullptr) continue;
+
+			if (requestDecode(fh, false) == 0) count++;
+		}
+	}
+
+	return count;
+}
+
+
+
+
+
+int sdliv::FileHandler::requestDecode(FileHandler * fh, bool urgent, bool full)
+{
+	SDL_assert(fh != nullptr);
+
+	int target_width = 0;
+	int target_height = 0;
+	if (reduced_decode && !full && fh->window != nullptr)
+	{
+		target_width = fh->window->getWidth();
+		target_height = fh->window->getHeight();
+	}
+
+	//a fitted copy comes back with it, from the same decode; a full
+	//decode is for zooming in, where it wouldn't be drawn
+	int fit_width = 0;
+	int fit_height = 0;
+	if (!full && fh->window != nullptr)
+	{
+		fit_width = fh->window->getWidth();
+		fit_height = fh->window->getHeight();
+	}
+
+	handlers[fh->ID] = fh;
+	return Loader::request(fh->ID, fh->getPathAsString(), urgent, target_width, target_height,
+			false, fit_width, fit_height);
+}
+
+
+
+
+
+int sdliv::FileHandler::requestFullResolution()
+{
+	if (active_image == nullptr || !Loader::isInit()) return -1;
+
+	Element * e = active_image->getElement();
+	if (e == nullptr || !e->isReduced()) return 0;
+
+	return requestDecode(active_image, true, true);
+}
+
+
+
+
+
+int sdliv::FileHandler::requestScaled(int width, int height)
+{
+	if (active_image == nullptr || !Loader::isInit()) return -1;
+
+	Element * e = active_image->getElement();
+	if (e == nullptr || e->hasScaled(width, height)) return 0;
+
+	return Loader::request(active_image->ID, active_image->getPathAsString(), false, width, height, true);
+}
+
+
+
+
+
+bool sdliv::FileHandler::receiveScaled(int id, SDL_Surface * s)
+{
+	perf::Span span("FileHandler::receiveScaled");
+
+	if (s == nullptr) return false;
+
+	//only asked for the active file, a copy for one we've left is no use
+	Element * e = (active_image != nullptr && active_image->ID == id) ? active_image->getElement() : nullptr;
+	if (e == nullptr)
+	{
+		SDL_FreeSurface(s);
+		return false;
+	}
+
+	if (e->addScaled(s)) return false;
+
+	//the element holds more texture memory than the cache last saw
+	ImageCache::recount();
+	return true;
+}
+
+
+
+
+
+void sdliv::FileHandler::setReducedDecode(bool reduced)
+{
+	reduced_decode = reduced;
+}
+
+
+
+
+
+sdliv::FileHandler * sdliv::FileHandler::getActiveFile()
+{
+	return active_image;
+}
+
+
+
+
+
+bool sdliv::FileHandler::onImageDecoded(SDL_Event * e)
+{
+	perf::Span span("FileHandler::onImageDecoded");
+
+	SDL_assert(e != nullptr);
+	SDL_assert(e->type == Loader::getEventType());
+
+	int id = e->user.code;
+	Loader::Result * r = (Loader::Result*) e->user.data1;
+	SDL_assert(r != nullptr);
+
+	SDL_Surface * s = r->surface;
+	SDL_Surface * fitted = r->fitted;
+	int full_width = r->full_width;
+	int full_height = r->full_height;
+	bool exact = r->exact;
+	delete r;
+
+	Loader::finish(id, exact);
+
+	if (exact) return receiveScaled(id, s);
+
+	auto iter = handlers.find(id);
+	if (iter == handlers.end() || s == nullptr)
+	{
+		if (fitted != nullptr) SDL_FreeSurface(fitted);
+		fitted = nullptr;
+	}
+
+	if (iter == handlers.end())
+	{
+		//file was untracked while it was decoding
+		if (s != nullptr) SDL_FreeSurface(s);
+		return false;
+	}
+
+	FileHandler * fh = iter->second;
+	handlers.erase(iter);
+
+	if (s == nullptr)
+	{
+		//let the synchronous path report what went wrong with the active file
+		if (fh == active_image) return true;
+
+		//lazily tracked files that turn out not to be images leave quietly
+		if (fh->type == FILETYPE_UNKNOWN)
+		{
+			size_t index = indexOf(fh);
+			if (index != npos) untrack(index);
+			return false;
+		}
+
+		log("sdliv::FileHandler::onImageDecoded() -- decode failed", fh->getPathAsString());
+		return false;
+	}
+
+	Element * cached = (fh->refreshKey() == 0) ? fh->getElement() : nullptr;
+	bool reduced = s->w < full_width || s->h < full_height;
+	if (cached != nullptr && (!cached->isReduced() || reduced))
+	{
+		//already read synchronously in the meantime, the fitted copy
+		//may still be new to it
+		SDL_FreeSurface(s);
+		if (fitted != nullptr && cached->addScaled(fitted) == 0) ImageCache::recount();
+		return false;
+	}
+
+	fh->receive(s, full_width, full_height);
+
+	if (fitted != nullptr)
+	{
+		Element * received = fh->getElement();
+
+		//the element holds more texture memory than the cache last saw
+		if (received == nullptr) SDL_FreeSurface(fitted);
+		else if (received->addScaled(fitted) == 0) ImageCache::recount();
+	}
+
+	return fh == active_image;
+}
+
+
+
+
+
+bool sdliv::FileHandler::onDirectoryChanged(SDL_Event * e)
+{
+	perf::Span span("FileHandler::onDirectoryChanged");
+
+	SDL_assert(e != nullptr);
+	SDL_assert(e->type == DirectoryWatcher::getEventType());
+
+	std::string * path = (std::string*) e->user.data1;
+	SDL_assert(path != nullptr);
+
+	bool active_changed = false;
+
+	switch (e->user.code)
+	{
+		case DirectoryWatcher::WATCH_ADDED:
+		case DirectoryWatcher::WATCH_MODIFIED:
+		{
+			//whatever was decoded for this path is stale now
+			ImageCache::invalidate(*path);
+
+			std::error_code ec;
+			std::filesystem::directory_entry f(*path, ec);
+			if (ec || !f.is_regular_file(ec)) break;
+
+			FileHandler * fh = openFileIfSupported(f, !lazy_detection);
+			if (fh == nullptr) break;
+
+			//file contents may be different, detect again when it's viewed
+			if (e->user.code == DirectoryWatcher::WATCH_MODIFIED) fh->type = FILETYPE_UNKNOWN;
+
+			if (fh == active_image) active_changed = true;
+			else prefetch();
+			break;
+		}
+
+		case DirectoryWatcher::WATCH_REMOVED:
+		{
+			ImageCache::invalidate(*path);
+
+			FileHandler * fh = findTracked(*path);
+			if (fh == nullptr) break;
+
+			//update() on the active image moves on to a file that still exists
+			if (fh == active_image)
 			{
-				//**FIXME** we have no images left, return a placeholder ?
-				active_image = nullptr;
-				return -1;
+				active_changed = true;
+				break;
 			}
-			iter = tracked_files.begin();
+
+			untrack(indexOf(fh));
+			prefetch();
+			break;
+		}
+
+		case DirectoryWatcher::WATCH_RESCAN:
+			log("sdliv::FileHandler::onDirectoryChanged() -- rescanning", workingDirectory.path().string());
+			rescanDirectory();
+			active_changed = true;
+			break;
+
+		default:
+			log("sdliv::FileHandler::onDirectoryChanged() -- unknown change", e->user.code);
+			break;
+	}
+
+	delete path;
+	return active_changed;
+}
+
+
+
+
+
+bool sdliv::FileHandler::onDirectoryScanned(SDL_Event * e)
+{
+	perf::Span span("FileHandler::onDirectoryScanned");
+
+	SDL_assert(e != nullptr);
+	SDL_assert(e->type == DirectoryScanner::getEventType());
+
+	DirectoryScanner::Batch * batch = (DirectoryScanner::Batch*) e->user.data1;
+	SDL_assert(batch != nullptr);
+
+	if (batch->generation != DirectoryScanner::getGeneration())
+	{
+		//left over from a scan that was replaced
+		delete batch;
+		return false;
+	}
+
+	std::vector<FileHandler*> fresh;
+	fresh.reserve(batch->entries.size());
+
+	for (auto & f : batch->entries)
+	{
+		//the file opened from the command line is already tracked
+		FileHandler * tracked = findTracked(f.path());
+		if (tracked != nullptr)
+		{
+			tracked->listed = true;
+			continue;
+		}
+
+		FileHandler * fh = new FileHandler(f, !lazy_detection);
+		if (fh->type == FILETYPE_UNSUPPORTED)
+		{
+			delete fh;
+			continue;
+		}
+
+		fresh.push_back(fh);
+	}
+
+	bool last = batch->last;
+	delete batch;
+
+	bool had_active = (active_image != nullptr);
+	if (!fresh.empty()) trackBatch(fresh);
+	if (last && rescanning) untrackUnlisted();
+
+	//neighbours of the active image may have just appeared
+	if (!fresh.empty() || last)
+	{
+		updateTitle();
+		prefetch();
+	}
+
+	if (last)
+	{
+		log("sdliv::FileHandler::onDirectoryScanned() -- tracking", (int) tracked_files.size(), "files");
+		requestThumbnails();
+	}
+
+	return !had_active && !tracked_files.empty();
+}
+
+
+
+
+
+bool sdliv::FileHandler::onThumbnailsStored(SDL_Event * e)
+{
+	SDL_assert(e != nullptr);
+	SDL_assert(e->type == ThumbnailStore::getEventType());
+
+	std::string * dir = (std::string*) e->user.data1;
+	SDL_assert(dir != nullptr);
+
+	bool current = (*dir == workingDirectory.path().string());
+	if (current) ThumbnailStore::reload();
+
+	delete dir;
+	return current;
+}
+
+
+
+
+
+int sdliv::FileHandler::requestThumbnails()
+{
+	if (!ThumbnailStore::isInit()) return -1;
+
+	//the generator stats each file itself, this stays a quick copy
+	std::vector<std::string> paths;
+	paths.reserve(tracked_files.size());
+
+	//start from the active image so what's nearby gets done first
+	size_t start = (active_image == nullptr) ? 0 : active_index;
+	for (size_t i = 0; i < tracked_files.size(); i++)
+	{
+		paths.push_back(tracked_files[(start + i) % tracked_files.size()]->getPathAsString());
+	}
+
+	return ThumbnailStore::request(workingDirectory.path(), paths);
+}
+
+
+
+
+
+sdliv::FileHandler * sdliv::FileHandler::findTracked(const std::filesystem::path & path)
+{
+	auto iter = tracked_paths.find(relativePath(path));
+	return (iter == tracked_paths.end()) ? nullptr : iter->second;
+}
+
+
+
+
+
+int sdliv::FileHandler::setPrefetchRadius(int radius)
+{
+	if (radius < 0)
+	{
+		log("sdliv::FileHandler::setPrefetchRadius() called with negative radius");
+		return -1;
+	}
+
+	prefetch_radius = radius;
+	return 0;
+}
+
+
+
+
+
+sdliv::Element * sdliv::FileHandler::nextImage()
+{
+	//the watcher keeps tracked_files current, otherwise poll for changes
+	if (!DirectoryWatcher::isWatching()) openDirectory(false);
+	if (tracked_files.size() == 0)
+	{
+		log("sdliv::FileHandler::nextImage() -- not tracking any files");
+		return nullptr;
+	}
+
+	if (active_image == nullptr)
+	{
+		active_index = 0;
+	}
+	else
+	{
+		active_index = (active_index + 1) % tracked_files.size();
+	}
+
+	active_image = tracked_files[active_index];
+
+	return activate(true);
+}
+
+
+
+
+
+sdliv::Element * sdliv::FileHandler::prevImage()
+{
+	if (!DirectoryWatcher::isWatching()) openDirectory(false);
+	if (tracked_files.size() == 0)
+	{
+		log("sdliv::FileHandler::prevImage() -- not tracking any files");
+		return nullptr;
+	}
+
+	if (active_image == nullptr || active_index == 0)
+	{
+		active_index = tracked_files.size() - 1;
+	}
+	else
+	{
+		active_index--;
+	}
+
+	active_image = tracked_files[active_index];
+
+	return activate(true);
+}
+
+
+
+
+
+//non-static methods
+sdliv::FileHandler::FileHandler()
+{
+	ID = ++ID_count;
+	type = FILETYPE_UNSUPPORTED;
+	rwops = nullptr;
+	window = Window::getFirstWindow();
+	listed = true;
+	key_valid = false;
+	mtime = std::filesystem::file_time_type();
+	file_size = 0;
+}
+
+
+
+
+
+sdliv::FileHandler::FileHandler(const std::filesystem::directory_entry & file, bool detect) : sdliv::FileHandler::FileHandler()
+{
+	setTarget(file, detect);
+}
+
+
+
+
+sdliv::FileHandler::FileHandler(const char * filename) : sdliv::FileHandler::FileHandler(std::string(filename))
+{}
+
+
+
+
+
+sdliv::FileHandler::FileHandler(const std::string & filename) : sdliv::FileHandler::FileHandler(std::filesystem::directory_entry(sdliv::FileHandler::workingDirectory.path() / filename))
+{}
+
+
+
+
+
+sdliv::FileHandler::FileHandler(const sdliv::FileHandler & fh)
+{
+	// **FIXME** this implementation _will_ cause problems with the destructor
+	log("sdliv::FileHandler::FileHandler(const sdliv::FileHandler&) -- copy constructor called");
+
+	ID = fh.ID;
+	type = fh.type;
+	rwops = fh.rwops;
+	window = fh.window;
+	relative_path = fh.relative_path;
+	listed = fh.listed;
+	key_valid = fh.key_valid;
+	mtime = fh.mtime;
+	file_size = fh.file_size;
+}
+
+
+
+
+
+sdliv::FileHandler::~FileHandler()
+{
+	//loader results for this ID will be dropped by onImageDecoded()
+	if (handlers.count(ID) > 0 && handlers[ID] == this) handlers.erase(ID);
+
+	//nobody can ask for this file's pixels anymore
+	if (key_valid) ImageCache::invalidate(getCacheKey());
+
+	//cleanup rwops
+	if (rwops != nullptr) close();
+
+	if (lookup_counted == this) lookup_counted = nullptr;
+}
+
+
+
+std::filesystem::path sdliv::FileHandler::parent_path() const
+{
+	return getPath().parent_path();
+}
+
+
+
+std::filesystem::path sdliv::FileHandler::getPath() const
+{
+	//an absolute relative_path replaces the directory
+	return workingDirectory.path() / relative_path;
+}
+
+
+
+std::string_view sdliv::FileHandler::sortName() const
+{
+	//in a recursive scan files sort by their path below the working
+	//directory, anything outside it by file name
+	std::string_view name = relative_path;
+	if (!std::filesystem::path(relative_path).is_absolute()) return name;
+
+	size_t slash = name.find_last_of("/\\");
+	return (slash == std::string_view::npos) ? name : name.substr(slash + 1);
+}
+
+
+
+std::string_view sdliv::FileHandler::sortExtension() const
+{
+	//as std::filesystem::path::extension(), a leading dot isn't one
+	std::string_view name = relative_path;
+	size_t slash = name.find_last_of("/\\");
+	if (slash != std::string_view::npos) name = name.substr(slash + 1);
+
+	size_t dot = name.rfind('.');
+	if (dot == std::string_view::npos || dot == 0) return std::string_view();
+	return name.substr(dot);
+}
+
+
+
+int sdliv::FileHandler::setTarget(const char * fn)
+{
+	return setTarget(std::string(fn));
+}
+
+
+
+
+
+int sdliv::FileHandler::setTarget(const std::string & fn)
+{
+	//filename is _not_ the full path
+	std::filesystem::path p = sdliv::FileHandler::workingDirectory.path() / fn;
+	return setTarget(std::filesystem::directory_entry(p));
+}
+
+
+int sdliv::FileHandler::setTarget(const std::filesystem::directory_entry & file, bool detect)
+{
+	relative_path = relativePath(file.path());
+
+	std::error_code ec;
+	if (!file.is_regular_file(ec))
+	{
+		log("sdliv::FileHandler:;setTarget() -- file does not exist", file.path().string());
+	}
+
+	type = detect ? detectImageType() : FILETYPE_UNKNOWN;
+	return 0;
+}
+
+
+
+
+
+namespace
+{
+	//'.' in mask means any byte is accepted at that offset
+	typedef struct
+	{
+		sdliv::ImageFileType type;
+		size_t length;
+		const char * magic;
+		const char * mask;
+	} Signature;
+
+	//order matters where signatures overlap, first match wins
+	constexpr Signature signatures[] = {
+		{ sdliv::FILETYPE_PNG,  8, "\x89PNG\r\n\x1a\n",  "xxxxxxxx" },
+		{ sdliv::FILETYPE_JPG,  3, "\xff\xd8\xff",       "xxx" },
+		{ sdliv::FILETYPE_GIF,  6, "GIF87a",             "xxxxxx" },
+		{ sdliv::FILETYPE_GIF,  6, "GIF89a",             "xxxxxx" },
+		{ sdliv::FILETYPE_WEBP, 12, "RIFF....WEBP",      "xxxx....xxxx" },
+		{ sdliv::FILETYPE_TIF,  4, "II*\0",              "xxxx" },
+		{ sdliv::FILETYPE_TIF,  4, "MM\0*",              "xxxx" },
+		{ sdliv::FILETYPE_BMP,  2, "BM",                 "xx" },
+		{ sdliv::FILETYPE_ICO,  4, "\0\0\1\0",           "xxxx" },
+		{ sdliv::FILETYPE_CUR,  4, "\0\0\2\0",           "xxxx" },
+		{ sdliv::FILETYPE_LBM,  12, "FORM....ILBM",      "xxxx....xxxx" },
+		{ sdliv::FILETYPE_LBM,  12, "FORM....PBM ",      "xxxx....xxxx" },
+		{ sdliv::FILETYPE_PCX,  3, "\x0a\x05\x01",       "xxx" },
+		{ sdliv::FILETYPE_PCX,  3, "\x0a\x05\x00",       "xxx" },
+		{ sdliv::FILETYPE_XV,   6, "P7 332",             "xxxxxx" },
+		{ sdliv::FILETYPE_PNM,  2, "P1",                 "xx" },
+		{ sdliv::FILETYPE_PNM,  2, "P2",                 "xx" },
+		{ sdliv::FILETYPE_PNM,  2, "P3",                 "xx" },
+		{ sdliv::FILETYPE_PNM,  2, "P4",                 "xx" },
+		{ sdliv::FILETYPE_PNM,  2, "P5",                 "xx" },
+		{ sdliv::FILETYPE_PNM,  2, "P6",                 "xx" },
+		{ sdliv::FILETYPE_XCF,  9, "gimp xcf ",          "xxxxxxxxx" },
+		{ sdliv::FILETYPE_XPM,  9, "/* XPM */",          "xxxxxxxxx" },
+	};
+
+	static_assert(sizeof("RIFF....WEBP") - 1 <= sdliv::FileHandler::sniff_length,
+			"sniff_length too short for signature table");
+
+	//read up to length bytes from the start of path into buf
+	//returns the number of bytes read or -1
+	int readHeader(const std::string & path, unsigned char * buf, size_t length)
+	{
+#ifndef WIN32
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return -1;
+
+		ssize_t n = pread(fd, buf, length, 0);
+		::close(fd);
+
+		return (n < 0) ? -1 : (int) n;
+#else
+		FILE * f = fopen(path.c_str(), "rb");
+		if (f == nullptr) return -1;
+
+		size_t n = fread(buf, 1, length, f);
+		fclose(f);
+
+		return (int) n;
+#endif
+	}
+}
+
+
+
+
+
+sdliv::ImageFileType sdliv::FileHandler::sniffImageType(const unsigned char * header, size_t length)
+{
+	for (const Signature & sig : signatures)
+	{
+		if (length < sig.length) continue;
+
+		size_t i = 0;
+		while (i < sig.length && (sig.mask[i] == '.' || header[i] == (unsigned char) sig.magic[i]))
+		{
+			i++;
 		}
-		active_image = *(iter);
 
-		return active_image->update();
+		if (i == sig.length) return sig.type;
+	}
+
+	return FILETYPE_UNSUPPORTED;
+}
+
+
+
+
+
+sdliv::ImageFileType sdliv::FileHandler::detectImageType()
+{
+	perf::ScopedTimer timer(perf::STAGE_DETECT);
+
+	unsigned char header[sniff_length];
+
+	int n = readHeader(getPathAsString(), header, sniff_length);
+	if (n < 0)
+	{
+		type = FILETYPE_UNSUPPORTED;
+		return type;
+	}
+
+	type = sniffImageType(header, n);
+	if (type != FILETYPE_UNSUPPORTED) return type;
+
+	//SVG is text, only it needs a real probe
+	bool close_when_done = false;
+	if (rwops == nullptr)
+	{
+		if (open())
+		{
+			type = FILETYPE_UNSUPPORTED;
+			return type;
+		}
+
+		close_when_done = true;
 	}
-	//**FIXME** what if file was deleted between exists() and refresh()?
-	// if refresh is first, .exists and .status cause crashes
-	// could check .exists, then .refresh, then .exists again, but thats a lot of OS calls.
-	fs_entry.refresh();
-	if (element == nullptr || fs_entry.last_write_time() > timestamp)
+
+	if (IMG_isSVG(rwops))  { type = FILETYPE_SVG; }
+	else                        { type = FILETYPE_UNSUPPORTED; }
+
+	if (close_when_done) close();
+	return type;
+}
+
+
+
+
+
+int sdliv::FileHandler::update()
+{
+	perf::Span span("FileHandler::update");
+
+	if (type == FILETYPE_UNKNOWN) detectImageType();
+
+	if (type == FILETYPE_UNSUPPORTED || !std::filesystem::exists(getPath()))
 	{
-		if (fs_entry.last_write_time() > timestamp)
+		// **FIXME** this assumes we want the next file, not the previous
+		if (type == FILETYPE_UNSUPPORTED)
+		{
+			log("sdliv::FileHandler::update() -- not a supported image, dropping", getPathAsString());
+		}
+		else
+		{
+			log("sdliv::FileHandler::update() -- file no longer exists");
+		}
+		//untrack() deletes this, only statics from here on
+		size_t index = untrack(indexOf(this));
+		if (tracked_files.empty())
 		{
-			log("sdliv::FileHandler::update() -- file changed since last read");
+			//**FIXME** we have no images left, return a placeholder ?
+			active_image = nullptr;
+			return -1;
+		}
+		if (index >= tracked_files.size())
+		{
+			index = 0;
 		}
+		active_index = index;
+		active_image = tracked_files[index];
+
+		return active_image->update();
+	}
+	//**FIXME** what if file was deleted between exists() and refreshKey()?
+	bool had_key = key_valid;
+	ImageCache::Key old_key = getCacheKey();
+	refreshKey();
+
+	if (had_key && !(old_key == getCacheKey()))
+	{
+		log("sdliv::FileHandler::update() -- file changed since last read");
+		ImageCache::invalidate(old_key);
+	}
+
+	bool counted = (lookup_counted == this);
+	lookup_counted = nullptr;
 
+	Element * cached = counted ? ImageCache::touch(getCacheKey()) : ImageCache::get(getCacheKey());
+	if (cached == nullptr)
+	{
 		open();
 		read();
 		close();
 	}
 
-	sdliv::Window::setWindowTitle(fs_entry.path().filename().string());
+	updateTitle();
 	return 0;
 }
 
@@ -519,7 +1583,9 @@ int sdliv::FileHandler::update()
 
 int sdliv::FileHandler::open()
 {
-	rwops = SDL_RWFromFile(fs_entry.path().string().c_str(), "rb");
+	perf::ScopedTimer timer(perf::STAGE_OPEN);
+
+	rwops = SDL_RWFromFile(getPathAsString().c_str(), "rb");
 	return (rwops == nullptr) ? -1 : 0;
 }
 
@@ -529,6 +1595,8 @@ int sdliv::FileHandler::open()
 
 int sdliv::FileHandler::read()
 {
+	perf::Span span("FileHandler::read");
+
 	SDL_assert(window != nullptr);
 
 	if (rwops == nullptr)
@@ -544,21 +1612,121 @@ int sdliv::FileHandler::read()
 		case FILETYPE_UNSUPPORTED:
 			log("sdliv::FileHandler::read() -- file type unsupported");
 			return -1;
+		case FILETYPE_JPG:
+			if (readDirect() == 0) return 0;
+			//fall through
 		default:
+		{
+			perf::ScopedTimer timer(perf::STAGE_DECODE);
 			s = IMG_Load_RW(rwops,0);
+			if (s != nullptr) perf::add(perf::COUNTER_BYTES_DECODED, (std::uint64_t) s->pitch * s->h);
 			break;
+		}
+	}
+
+	return receive(s);
+}
+
+
+
+
+
+int sdliv::FileHandler::readDirect()
+{
+	perf::Span span("FileHandler::readDirect");
+
+	if (!key_valid && refreshKey()) return -1;
+
+	//straight into texture memory, nothing to convert or copy on the way
+	//full size like the rest of the synchronous path, nothing would
+	//fetch the detail later
+	Element * e = window->createElement();
+	if (e->createFromDecoder(getPathAsString()))
+	{
+		window->removeElement(e);
+		delete e;
+		return -1;
+	}
+
+	return (ImageCache::adopt(window, getCacheKey(), e) == nullptr) ? -1 : 0;
+}
+
+
+
+
+
+int sdliv::FileHandler::receive(SDL_Surface * s, int full_width, int full_height)
+{
+	perf::Span span("FileHandler::receive");
+
+	SDL_assert(window != nullptr);
+
+	if (s == nullptr)
+	{
+		log("sdliv::FileHandler::receive() -- no surface", IMG_GetError());
+		return -1;
+	}
+
+	if (!key_valid && refreshKey())
+	{
+		SDL_FreeSurface(s);
+		return -1;
+	}
+
+	bool reduced = (full_width > s->w || full_height > s->h);
+
+	Element * e = ImageCache::insert(window, getCacheKey(), s);
+	if (e == nullptr) return -1;
+
+	//zoom works in full size pixels whatever was decoded
+	if (reduced) e->setLogicalSize(full_width, full_height);
+
+	return 0;
+}
+
+
+
+
+
+bool sdliv::FileHandler::getThumbnail(ThumbnailStore::Thumbnail * thumbnail)
+{
+	if (!key_valid && refreshKey()) return false;
+
+	return ThumbnailStore::lookup(getPathAsString(), mtime, file_size, thumbnail);
+}
+
+
+
+
+
+int sdliv::FileHandler::refreshKey()
+{
+	std::error_code ec;
+
+	std::filesystem::file_time_type t = std::filesystem::last_write_time(getPath(), ec);
+	if (ec)
+	{
+		log("sdliv::FileHandler::refreshKey() -- failed to stat", getPathAsString());
+		return -1;
 	}
 
-	if (element != nullptr)
+	std::uintmax_t size = std::filesystem::file_size(getPath(), ec);
+	if (ec)
 	{
-		log("sdliv::FileHandler::read() -- deleting old element");
-		if (window != nullptr) window->removeElement(element);
-		delete element;
-		element = nullptr;
+		log("sdliv::FileHandler::refreshKey() -- failed to stat", getPathAsString());
+		return -1;
 	}
 
-	element = window->createElement();
-	element->createFromSurface(s);
+	//in these orders the new stat may move the file, find it with the old keys
+	bool moves = (sort_order == SORT_MTIME || sort_order == SORT_SIZE)
+			&& key_valid && (t != mtime || size != file_size);
+	size_t index = moves ? indexOf(this) : npos;
+
+	mtime = t;
+	file_size = size;
+	key_valid = true;
+
+	if (index != npos) reposition(index);
 
 	return 0;
 }
@@ -567,6 +1735,26 @@ int sdliv::FileHandler::read()
 
 
 
+sdliv::ImageCache::Key sdliv::FileHandler::getCacheKey() const
+{
+	return { getPathAsString(), mtime, file_size };
+}
+
+
+
+
+
+sdliv::Element * sdliv::FileHandler::getElement() const
+{
+	if (!key_valid) return nullptr;
+
+	return ImageCache::peek(getCacheKey());
+}
+
+
+
+
+
 int sdliv::FileHandler::close()
 {
 	if (rwops == nullptr)
@@ -99,6 +99,28 @@ sdliv::Font * sdliv::Font::openFont(Window * w, const char * path, int fs)
 }
 
 
+
+
+
+int sdliv::Font::restoreTextures()
+{
+	int error = 0;
+
+	for (auto & p : font_objects)
+	{
+		for (auto & a : p.second->atlases)
+		{
+			if (a.second->restoreTexture()) error = -1;
+		}
+	}
+
+	return error;
+}
+
+
+
+
+
 sdliv::Font::Font()
 {
 	ID = 0;
@@ -164,6 +186,13 @@ int sdliv::Font::close()
 
 	if (error) return -1;
 
+	//before the font, the atlases render from it
+	for (auto & p : atlases)
+	{
+		delete p.second;
+	}
+	atlases.clear();
+
 	TTF_CloseFont(font);
 	font = nullptr;
 	renderer = nullptr;
@@ -252,3 +281,26 @@ SDL_Surface * sdliv::Font::renderText(const std::string & txt)
 {
 	return renderText(txt.c_str());
 }
+
+
+
+
+
+sdliv::GlyphAtlas * sdliv::Font::getAtlas()
+{
+	if (font == nullptr || renderer == nullptr)
+	{
+		log("sdliv::Font::getAtlas() called on a closed font");
+		return nullptr;
+	}
+
+	Uint32 key = ((Uint32) c.r << 24) | ((Uint32) c.g << 16) | ((Uint32) c.b << 8) | c.a;
+
+	auto it = atlases.find(key);
+	if (it != atlases.end()) return it->second;
+
+	GlyphAtlas * a = new GlyphAtlas(renderer, font, c);
+	atlases[key] = a;
+
+	return a;
+}
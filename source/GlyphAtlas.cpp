@@ -0,0 +1,337 @@
+#include <sdliv.h>
+
+
+
+
+
+namespace
+{
+	//next code point of UTF-8 text, anything malformed comes out as '?'
+	Uint32 nextCodepoint(const unsigned char ** p)
+	{
+		const unsigned char * s = *p;
+		Uint32 cp = s[0];
+		int extra = 0;
+
+		if (cp < 0x80) extra = 0;
+		else if ((cp & 0xE0) == 0xC0) { cp &= 0x1F; extra = 1; }
+		else if ((cp & 0xF0) == 0xE0) { cp &= 0x0F; extra = 2; }
+		else if ((cp & 0xF8) == 0xF0) { cp &= 0x07; extra = 3; }
+		else
+		{
+			*p = s + 1;
+			return '?';
+		}
+
+		for (int i = 1; i <= extra; i++)
+		{
+			if ((s[i] & 0xC0) != 0x80)
+			{
+				*p = s + i;
+				return '?';
+			}
+			cp = (cp << 6) | (s[i] & 0x3F);
+		}
+
+		*p = s + 1 + extra;
+		return cp;
+	}
+}
+
+
+
+
+
+sdliv::GlyphAtlas::GlyphAtlas(SDL_Renderer * r, TTF_Font * f, SDL_Color c)
+{
+	SDL_assert(r != nullptr && f != nullptr);
+
+	renderer = r;
+	font = f;
+	color = c;
+	line_height = TTF_FontHeight(f);
+
+	pixels = SDL_CreateRGBSurfaceWithFormat(0, constants::glyph_atlas_size, constants::glyph_atlas_size,
+			32, SDL_PIXELFORMAT_ARGB8888);
+	if (pixels == nullptr)
+	{
+		log("sdliv::GlyphAtlas::GlyphAtlas() -- SDL_CreateRGBSurfaceWithFormat() failed", SDL_GetError());
+	}
+
+	texture = nullptr;
+	pen_x = 0;
+	pen_y = 0;
+	row_height = 0;
+
+	restoreTexture();
+}
+
+
+
+
+
+//copy constructor shouldn't really be used, log it!
+sdliv::GlyphAtlas::GlyphAtlas(const GlyphAtlas & a)
+{
+	log("Error: call to GlyphAtlas(const GlyphAtlas & a)");
+
+	//the glyphs stay with the original, this one starts empty
+	renderer = a.renderer;
+	font = a.font;
+	color = a.color;
+	line_height = a.line_height;
+	pixels = nullptr;
+	texture = nullptr;
+	pen_x = 0;
+	pen_y = 0;
+	row_height = 0;
+}
+
+
+
+
+
+sdliv::GlyphAtlas::~GlyphAtlas()
+{
+	if (texture != nullptr) SDL_DestroyTexture(texture);
+	if (pixels != nullptr) SDL_FreeSurface(pixels);
+
+	texture = nullptr;
+	pixels = nullptr;
+	glyphs.clear();
+}
+
+
+
+
+
+SDL_Texture * sdliv::GlyphAtlas::getTexture() const
+{
+	return texture;
+}
+
+
+
+
+
+int sdliv::GlyphAtlas::getWidth() const
+{
+	return pixels != nullptr ? pixels->w : 0;
+}
+
+
+
+
+
+int sdliv::GlyphAtlas::getHeight() const
+{
+	return pixels != nullptr ? pixels->h : 0;
+}
+
+
+
+
+
+int sdliv::GlyphAtlas::getLineHeight() const
+{
+	return line_height;
+}
+
+
+
+
+
+size_t sdliv::GlyphAtlas::getTextureBytes() const
+{
+	if (texture == nullptr || pixels == nullptr) return 0;
+	return (size_t) pixels->pitch * pixels->h;
+}
+
+
+
+
+
+int sdliv::GlyphAtlas::restoreTexture()
+{
+	if (pixels == nullptr) return -1;
+
+	//the old one went with the device, if it was lost
+	if (texture != nullptr) SDL_DestroyTexture(texture);
+
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, pixels->w, pixels->h);
+	if (texture == nullptr)
+	{
+		log("sdliv::GlyphAtlas::restoreTexture() -- SDL_CreateTexture() failed", SDL_GetError());
+		return -1;
+	}
+
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+	if (SDL_UpdateTexture(texture, nullptr, pixels->pixels, pixels->pitch))
+	{
+		log("sdliv::GlyphAtlas::restoreTexture() -- SDL_UpdateTexture() failed", SDL_GetError());
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::GlyphAtlas::grow()
+{
+	SDL_Surface * bigger = SDL_CreateRGBSurfaceWithFormat(0, pixels->w, pixels->h * 2, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (bigger == nullptr)
+	{
+		log("sdliv::GlyphAtlas::grow() -- SDL_CreateRGBSurfaceWithFormat() failed", SDL_GetError());
+		return -1;
+	}
+
+	//straight copy, the glyphs keep their rects
+	SDL_SetSurfaceBlendMode(pixels, SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(pixels, nullptr, bigger, nullptr);
+
+	SDL_Surface * old = pixels;
+	pixels = bigger;
+
+	if (restoreTexture())
+	{
+		log("sdliv::GlyphAtlas::grow() -- failed at", old->w, "by", old->h * 2);
+		pixels = old;
+		SDL_FreeSurface(bigger);
+		restoreTexture();
+		return -1;
+	}
+
+	SDL_FreeSurface(old);
+	return 0;
+}
+
+
+
+
+
+const sdliv::GlyphAtlas::Glyph * sdliv::GlyphAtlas::getGlyph(Uint32 codepoint)
+{
+	auto it = glyphs.find(codepoint);
+	if (it != glyphs.end()) return &it->second;
+
+	Glyph g;
+	g.rect = { 0,0,0,0 };
+	g.advance = 0;
+
+	int minx, maxx, miny, maxy;
+	if (TTF_GlyphMetrics(font, (Uint16) codepoint, &minx, &maxx, &miny, &maxy, &g.advance))
+	{
+		//not in the font, remembered so it isn't asked for again
+		return &(glyphs[codepoint] = g);
+	}
+
+	//rendered as a one character string, so every glyph is a full line
+	//high with the baseline in the same place
+	char utf8[5] = { 0 };
+	if (codepoint < 0x80) utf8[0] = (char) codepoint;
+	else if (codepoint < 0x800)
+	{
+		utf8[0] = (char) (0xC0 | (codepoint >> 6));
+		utf8[1] = (char) (0x80 | (codepoint & 0x3F));
+	}
+	else
+	{
+		utf8[0] = (char) (0xE0 | (codepoint >> 12));
+		utf8[1] = (char) (0x80 | ((codepoint >> 6) & 0x3F));
+		utf8[2] = (char) (0x80 | (codepoint & 0x3F));
+	}
+
+	SDL_Surface * s = (pixels != nullptr && maxx > minx) ? TTF_RenderUTF8_Blended(font, utf8, color) : nullptr;
+	if (s == nullptr) return &(glyphs[codepoint] = g);
+
+	//next row if it doesn't fit on this one, a bigger atlas if there's no row left
+	if (pen_x + s->w > pixels->w)
+	{
+		pen_x = 0;
+		pen_y += row_height;
+		row_height = 0;
+	}
+
+	bool placed = s->w <= pixels->w;
+	while (placed && pen_y + s->h > pixels->h)
+	{
+		if (grow()) placed = false;
+	}
+
+	if (!placed)
+	{
+		log("sdliv::GlyphAtlas::getGlyph() -- no room for glyph", (int) codepoint);
+		SDL_FreeSurface(s);
+		return &(glyphs[codepoint] = g);
+	}
+
+	g.rect = { pen_x, pen_y, s->w, s->h };
+
+	SDL_SetSurfaceBlendMode(s, SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(s, nullptr, pixels, &g.rect);
+	SDL_FreeSurface(s);
+
+	//only the new glyph goes up, not the whole atlas
+	const Uint8 * src = (const Uint8 *) pixels->pixels + g.rect.y * pixels->pitch + g.rect.x * 4;
+	if (texture != nullptr && SDL_UpdateTexture(texture, &g.rect, src, pixels->pitch))
+	{
+		log("sdliv::GlyphAtlas::getGlyph() -- SDL_UpdateTexture() failed", SDL_GetError());
+	}
+
+	perf::add(perf::COUNTER_BYTES_UPLOADED, (std::uint64_t) g.rect.w * g.rect.h * 4);
+
+	pen_x += g.rect.w;
+	row_height = std::max(row_height, g.rect.h);
+
+	return &(glyphs[codepoint] = g);
+}
+
+
+
+
+
+int sdliv::GlyphAtlas::layout(const char * text, std::vector<Quad> * quads, int * w, int * h)
+{
+	SDL_assert(quads != nullptr);
+
+	if (text == nullptr)
+	{
+		log("sdliv::GlyphAtlas::layout() called with null text");
+		return -1;
+	}
+
+	int x = 0;
+	Uint32 previous = 0;
+	const unsigned char * p = (const unsigned char *) text;
+
+	while (*p != '\0')
+	{
+		Uint32 cp = nextCodepoint(&p);
+
+		//TTF_GlyphMetrics() only takes 16 bits
+		if (cp > 0xFFFF) cp = '?';
+
+		if (previous != 0) x += TTF_GetFontKerningSizeGlyphs(font, (Uint16) previous, (Uint16) cp);
+		previous = cp;
+
+		const Glyph * g = getGlyph(cp);
+		if (g->rect.w > 0)
+		{
+			Quad q;
+			q.src = g->rect;
+			q.dst = { x, 0, g->rect.w, g->rect.h };
+			quads->push_back(q);
+		}
+
+		x += g->advance;
+	}
+
+	if (w != nullptr) *w = x;
+	if (h != nullptr) *h = line_height;
+
+	return 0;
+}
@@ -0,0 +1,362 @@
+#include <sdliv.h>
+
+
+
+
+
+sdliv::GridView::GridView(Window * w)
+{
+	SDL_assert(w != nullptr);
+
+	window = w;
+	shown = false;
+	selected = 0;
+	scroll = 0;
+}
+
+
+
+
+
+//copy constructor shouldn't really be used, log it!
+sdliv::GridView::GridView(const GridView & g)
+{
+	log("Error: call to GridView(const GridView & g)");
+
+	window = g.window;
+	shown = false;
+	selected = g.selected;
+	scroll = g.scroll;
+}
+
+
+
+
+
+sdliv::GridView::~GridView()
+{
+	for (Element * e : pool)
+	{
+		window->removeElement(e);
+		delete e;
+	}
+
+	pool.clear();
+}
+
+
+
+
+
+int sdliv::GridView::getCellSize() const
+{
+	return constants::thumbnail_size + 2 * constants::grid_cell_padding;
+}
+
+
+
+
+
+int sdliv::GridView::getColumns() const
+{
+	return std::max(1, window->getWidth() / getCellSize());
+}
+
+
+
+
+
+int sdliv::GridView::getVisibleRows() const
+{
+	//a partly scrolled sheet shows part of one more row top and bottom
+	return window->getHeight() / getCellSize() + 2;
+}
+
+
+
+
+
+int sdliv::GridView::resizePool()
+{
+	size_t wanted = (size_t) getColumns() * getVisibleRows();
+	if (wanted == pool.size()) return 0;
+
+	while (pool.size() > wanted)
+	{
+		window->removeElement(pool.back());
+		delete pool.back();
+		pool.pop_back();
+	}
+
+	while (pool.size() < wanted)
+	{
+		Element * e = window->createElement(constants::grid_layer);
+		if (e->createStreaming(constants::thumbnail_size, constants::thumbnail_size, SDL_PIXELFORMAT_ARGB8888))
+		{
+			window->removeElement(e);
+			delete e;
+			break;
+		}
+
+		pool.push_back(e);
+	}
+
+	//the slot each cell maps to depends on the pool size
+	slot_index.assign(pool.size(), npos);
+	slot_loaded.assign(pool.size(), false);
+
+	return pool.size() == wanted ? 0 : -1;
+}
+
+
+
+
+
+int sdliv::GridView::loadSlot(size_t slot, size_t index)
+{
+	slot_index[slot] = index;
+	slot_loaded[slot] = false;
+
+	FileHandler * fh = FileHandler::getTrackedFile(index);
+	if (fh == nullptr) return -1;
+
+	ThumbnailStore::Thumbnail t;
+	if (!fh->getThumbnail(&t)) return -1;
+
+	if (pool[slot]->updateTexture(t.pixels, t.pitch, t.width, t.height)) return -1;
+
+	slot_loaded[slot] = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::GridView::clampScroll()
+{
+	const long cell = getCellSize();
+	const long columns = getColumns();
+	const long rows = ((long) FileHandler::getTrackedCount() + columns - 1) / columns;
+	const long bottom = std::max(0L, rows * cell - window->getHeight());
+
+	scroll = std::min(std::max(scroll, 0L), bottom);
+	return 0;
+}
+
+
+
+
+
+int sdliv::GridView::scrollToSelected()
+{
+	const long cell = getCellSize();
+	const long top = (long) (selected / getColumns()) * cell;
+
+	if (top < scroll) scroll = top;
+	if (top + cell > scroll + window->getHeight()) scroll = top + cell - window->getHeight();
+
+	return clampScroll();
+}
+
+
+
+
+
+int sdliv::GridView::show()
+{
+	if (shown) return -1;
+
+	shown = true;
+	resizePool();
+	select(FileHandler::getActiveIndex());
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::GridView::hide()
+{
+	if (!shown) return -1;
+
+	shown = false;
+	return 0;
+}
+
+
+
+
+
+bool sdliv::GridView::isShown() const
+{
+	return shown;
+}
+
+
+
+
+
+int sdliv::GridView::invalidate()
+{
+	slot_index.assign(pool.size(), npos);
+	slot_loaded.assign(pool.size(), false);
+
+	if (selected >= FileHandler::getTrackedCount() && selected > 0)
+	{
+		selected = FileHandler::getTrackedCount() - 1;
+	}
+
+	return clampScroll();
+}
+
+
+
+
+
+int sdliv::GridView::refreshMissing()
+{
+	//loaded slots already have their pixels, only retry the others
+	for (size_t slot = 0; slot < pool.size(); slot++)
+	{
+		if (!slot_loaded[slot]) slot_index[slot] = npos;
+	}
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::GridView::select(size_t index)
+{
+	size_t count = FileHandler::getTrackedCount();
+	if (count == 0) return -1;
+
+	selected = std::min(index, count - 1);
+	return scrollToSelected();
+}
+
+
+
+
+
+size_t sdliv::GridView::getSelected() const
+{
+	return selected;
+}
+
+
+
+
+
+int sdliv::GridView::scrollBy(long pixels)
+{
+	scroll += pixels;
+	return clampScroll();
+}
+
+
+
+
+
+bool sdliv::GridView::onKey(SDL_Keycode key)
+{
+	const long columns = getColumns();
+	const long page = columns * std::max(1, window->getHeight() / getCellSize());
+	const long last = (long) FileHandler::getTrackedCount() - 1;
+
+	long target = (long) selected;
+
+	switch (key)
+	{
+		case SDLK_LEFT:     target -= 1; break;
+		case SDLK_RIGHT:    target += 1; break;
+		case SDLK_UP:       target -= columns; break;
+		case SDLK_DOWN:     target += columns; break;
+		case SDLK_PAGEUP:   target -= page; break;
+		case SDLK_PAGEDOWN: target += page; break;
+		case SDLK_HOME:     target = 0; break;
+		case SDLK_END:      target = last; break;
+		default:
+			return false;
+	}
+
+	if (last < 0) return true;
+
+	select((size_t) std::min(std::max(target, 0L), last));
+	return true;
+}
+
+
+
+
+
+int sdliv::GridView::draw()
+{
+	if (!shown) return -1;
+
+	resizePool();
+	if (pool.empty()) return -1;
+
+	SDL_Renderer * r = window->getRenderingContext();
+
+	//the draw colour is the window background, put it back afterwards
+	Uint8 bg_r, bg_g, bg_b, bg_a;
+	SDL_GetRenderDrawColor(r, &bg_r, &bg_g, &bg_b, &bg_a);
+
+	const int cell = getCellSize();
+	const int pad = constants::grid_cell_padding;
+	const size_t columns = getColumns();
+	const size_t count = FileHandler::getTrackedCount();
+	const int height = window->getHeight();
+
+	//only rows that overlap the window, so cost doesn't depend on count
+	for (size_t row = scroll / cell; (long) row * cell - scroll < height; row++)
+	{
+		const int y = (int) ((long) row * cell - scroll);
+
+		for (size_t column = 0; column < columns; column++)
+		{
+			const size_t index = row * columns + column;
+			if (index >= count) break;
+
+			const int x = (int) column * cell;
+			const size_t slot = index % pool.size();
+
+			if (slot_index[slot] != index) loadSlot(slot, index);
+
+			if (slot_loaded[slot])
+			{
+				Element * e = pool[slot];
+				e->setDrawScale(1.0);
+				e->setDrawPosition(y + pad + (constants::thumbnail_size - e->getHeight()) / 2,
+						x + pad + (constants::thumbnail_size - e->getWidth()) / 2);
+				e->draw();
+			}
+
+			else
+			{
+				//placeholder until the ThumbnailStore gets to this file
+				SDL_Rect placeholder = { x + pad, y + pad, constants::thumbnail_size, constants::thumbnail_size };
+				SDL_SetRenderDrawColor(r, 40, 40, 40, 255);
+				SDL_RenderFillRect(r, &placeholder);
+			}
+
+			if (index == selected)
+			{
+				SDL_Rect outline = { x + pad / 2, y + pad / 2, cell - pad, cell - pad };
+				SDL_SetRenderDrawColor(r, 255, 255, 255, 255);
+				SDL_RenderDrawRect(r, &outline);
+			}
+		}
+
+		if ((row + 1) * columns >= count) break;
+	}
+
+	SDL_SetRenderDrawColor(r, bg_r, bg_g, bg_b, bg_a);
+	return 0;
+}
@@ -0,0 +1,224 @@
+#include <sdliv.h>
+
+
+
+
+
+namespace
+{
+	//"-" until there's something to show
+	std::string milliseconds(std::uint64_t ns)
+	{
+		if (ns == 0) return "-";
+
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.1f ms", ns / 1e6);
+		return buffer;
+	}
+
+	std::string mebibytes(size_t bytes)
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.1f MiB", bytes / (1024.0 * 1024.0));
+		return buffer;
+	}
+}
+
+
+
+
+
+sdliv::Hud::Hud(Window * w, Font * f)
+{
+	SDL_assert(w != nullptr);
+
+	window = w;
+	font = f;
+	shown = false;
+	frame_ns = 0;
+
+	lines.assign(FIELD_COUNT, nullptr);
+}
+
+
+
+
+
+//copy constructor shouldn't really be used, log it!
+sdliv::Hud::Hud(const Hud & h)
+{
+	log("Error: call to Hud(const Hud & h)");
+
+	window = h.window;
+	font = h.font;
+	shown = false;
+	frame_ns = 0;
+
+	lines.assign(FIELD_COUNT, nullptr);
+}
+
+
+
+
+
+sdliv::Hud::~Hud()
+{
+	for (TextElement * e : lines)
+	{
+		if (e == nullptr) continue;
+		window->removeElement(e);
+		delete e;
+	}
+
+	lines.clear();
+}
+
+
+
+
+
+int sdliv::Hud::show()
+{
+	shown = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Hud::hide()
+{
+	shown = false;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Hud::toggle()
+{
+	shown = !shown;
+	return 0;
+}
+
+
+
+
+
+bool sdliv::Hud::isShown() const
+{
+	return shown;
+}
+
+
+
+
+
+int sdliv::Hud::setFrameTime(std::uint64_t ns)
+{
+	frame_ns = ns;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Hud::setField(Field field, const std::string & text)
+{
+	if (lines[field] == nullptr)
+	{
+		lines[field] = window->createTextElement(font, constants::hud_layer);
+	}
+
+	TextElement * e = lines[field];
+	if (e->setText(text)) return -1;
+
+	//every line is the same font, so the same height
+	e->setDrawPosition(constants::hud_margin + field * e->getHeight(), constants::hud_margin);
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::Hud::refresh()
+{
+	int error = 0;
+	char buffer[256];
+
+	if (setField(FIELD_FRAME, "frame   " + milliseconds(frame_ns))) error = -1;
+	if (setField(FIELD_DECODE, "decode  " + milliseconds(perf::getLast(perf::STAGE_DECODE)))) error = -1;
+	if (setField(FIELD_UPLOAD, "upload  " + milliseconds(perf::getLast(perf::STAGE_UPLOAD)))) error = -1;
+
+	snprintf(buffer, sizeof(buffer), "cache   %.0f%% hits", ImageCache::getHitRate() * 100.0);
+	if (setField(FIELD_CACHE, buffer)) error = -1;
+
+	snprintf(buffer, sizeof(buffer), "queue   %d", Loader::isInit() ? Loader::getQueueDepth() : 0);
+	if (setField(FIELD_QUEUE, buffer)) error = -1;
+
+	if (setField(FIELD_MEMORY, "memory  " + mebibytes(ImageCache::getSurfaceBytes()) + " surfaces, "
+			+ mebibytes(ImageCache::getTextureBytes()) + " textures"))
+	{
+		error = -1;
+	}
+
+	FileHandler * fh = FileHandler::getActiveFile();
+	if (fh != nullptr)
+	{
+		snprintf(buffer, sizeof(buffer), "file    %d / %d  ",
+				(int) FileHandler::getActiveIndex() + 1, (int) FileHandler::getTrackedCount());
+		if (setField(FIELD_FILE, buffer + std::filesystem::path(fh->getPathAsString()).filename().string())) error = -1;
+	}
+	else if (setField(FIELD_FILE, "file    none")) error = -1;
+
+	return error;
+}
+
+
+
+
+
+int sdliv::Hud::draw()
+{
+	if (!shown) return -1;
+
+	if (font == nullptr)
+	{
+		log("sdliv::Hud::draw() called with no font");
+		return -1;
+	}
+
+	refresh();
+
+	//a dark backing so the text reads over any image
+	int width = 0, height = 0;
+	for (TextElement * e : lines)
+	{
+		if (e == nullptr) continue;
+		width = std::max(width, e->getDrawWidth());
+		height = std::max(height, e->getDrawYPos() + e->getDrawHeight());
+	}
+
+	SDL_Renderer * r = window->getRenderingContext();
+
+	Uint8 bg_r, bg_g, bg_b, bg_a;
+	SDL_BlendMode blend;
+	SDL_GetRenderDrawColor(r, &bg_r, &bg_g, &bg_b, &bg_a);
+	SDL_GetRenderDrawBlendMode(r, &blend);
+
+	SDL_Rect backing = { constants::hud_margin / 2, constants::hud_margin / 2,
+			width + constants::hud_margin, height };
+	SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(r, 0, 0, 0, 160);
+	SDL_RenderFillRect(r, &backing);
+
+	SDL_SetRenderDrawColor(r, bg_r, bg_g, bg_b, bg_a);
+	SDL_SetRenderDrawBlendMode(r, blend);
+
+	return window->drawLayer(constants::hud_layer);
+}
@@ -0,0 +1,332 @@
+#include <sdliv.h>
+
+
+std::map<sdliv::ImageCache::Key, sdliv::ImageCache::Entry> sdliv::ImageCache::entries
+		= std::map<sdliv::ImageCache::Key, sdliv::ImageCache::Entry>();
+std::list<sdliv::ImageCache::Key> sdliv::ImageCache::lru = std::list<sdliv::ImageCache::Key>();
+
+size_t sdliv::ImageCache::surface_budget = sdliv::constants::cache_surface_budget;
+size_t sdliv::ImageCache::texture_budget = sdliv::constants::cache_texture_budget;
+size_t sdliv::ImageCache::surface_bytes = 0;
+size_t sdliv::ImageCache::texture_bytes = 0;
+
+unsigned long sdliv::ImageCache::hits = 0;
+unsigned long sdliv::ImageCache::misses = 0;
+
+sdliv::Element * sdliv::ImageCache::pinned = nullptr;
+sdliv::Window * sdliv::ImageCache::pinned_window = nullptr;
+bool sdliv::ImageCache::pinned_orphaned = false;
+
+
+
+
+
+bool sdliv::ImageCache::Key::operator<(const Key & k) const
+{
+	if (path != k.path) return path.compare(k.path) < 0;
+	if (mtime != k.mtime) return mtime < k.mtime;
+	return size < k.size;
+}
+
+
+
+
+
+bool sdliv::ImageCache::Key::operator==(const Key & k) const
+{
+	return path == k.path && mtime == k.mtime && size == k.size;
+}
+
+
+
+
+
+sdliv::Element * sdliv::ImageCache::get(const Key & key)
+{
+	auto iter = entries.find(key);
+	if (iter == entries.end())
+	{
+		misses++;
+		return nullptr;
+	}
+
+	hits++;
+	lru.splice(lru.begin(), lru, iter->second.lru_position);
+
+	return iter->second.element;
+}
+
+
+
+
+
+sdliv::Element * sdliv::ImageCache::touch(const Key & key)
+{
+	auto iter = entries.find(key);
+	if (iter == entries.end()) return nullptr;
+
+	lru.splice(lru.begin(), lru, iter->second.lru_position);
+	return iter->second.element;
+}
+
+
+
+
+
+sdliv::Element * sdliv::ImageCache::peek(const Key & key)
+{
+	auto iter = entries.find(key);
+	return (iter == entries.end()) ? nullptr : iter->second.element;
+}
+
+
+
+
+
+bool sdliv::ImageCache::contains(const Key & key)
+{
+	return entries.count(key) > 0;
+}
+
+
+
+
+
+sdliv::Element * sdliv::ImageCache::insert(Window * w, const Key & key, SDL_Surface * s)
+{
+	SDL_assert(w != nullptr);
+
+	if (s == nullptr)
+	{
+		log("sdliv::ImageCache::insert() -- passed null surface");
+		return nullptr;
+	}
+
+	//images past the renderer's texture limit get tiled
+	//with a source the element frees s once its texture is up
+	Element * e = w->createElementFor(s);
+	e->setSource(key.path);
+	if (e->createFromSurface(s))
+	{
+		log("sdliv::ImageCache::insert() -- failed to create element", key.path);
+		w->removeElement(e);
+		delete e;
+		return nullptr;
+	}
+
+	return adopt(w, key, e);
+}
+
+
+
+
+
+sdliv::Element * sdliv::ImageCache::adopt(Window * w, const Key & key, Element * e)
+{
+	SDL_assert(w != nullptr && e != nullptr);
+
+	auto old = entries.find(key);
+	if (old != entries.end())
+	{
+		log("sdliv::ImageCache::adopt() -- replacing cached element", key.path);
+		erase(old);
+	}
+
+	lru.push_front(key);
+
+	Entry entry;
+	entry.element = e;
+	entry.window = w;
+	entry.surface_bytes = e->getSurfaceBytes();
+	entry.texture_bytes = e->getTextureBytes();
+	entry.lru_position = lru.begin();
+	entries[key] = entry;
+
+	surface_bytes += entry.surface_bytes;
+	texture_bytes += entry.texture_bytes;
+
+	evict(e);
+
+	return e;
+}
+
+
+
+
+
+int sdliv::ImageCache::erase(std::map<Key, Entry>::iterator iter)
+{
+	Entry & entry = iter->second;
+
+	if (entry.element == pinned)
+	{
+		//still on screen, delete it once something else is pinned
+		pinned_window = entry.window;
+		pinned_orphaned = true;
+	}
+	else
+	{
+		entry.window->removeElement(entry.element);
+		delete entry.element;
+	}
+
+	surface_bytes -= entry.surface_bytes;
+	texture_bytes -= entry.texture_bytes;
+
+	lru.erase(entry.lru_position);
+	entries.erase(iter);
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::ImageCache::evict(const Element * keep)
+{
+	int count = 0;
+	auto position = lru.end();
+
+	while ((surface_bytes > surface_budget || texture_bytes > texture_budget)
+			&& position != lru.begin())
+	{
+		auto candidate = std::prev(position);
+
+		auto iter = entries.find(*candidate);
+		SDL_assert(iter != entries.end());
+
+		Element * e = iter->second.element;
+		if (e == keep || e == pinned)
+		{
+			position = candidate;
+			continue;
+		}
+
+		//erasing candidate leaves position valid, it's a list
+		erase(iter);
+		count++;
+	}
+
+	return count;
+}
+
+
+
+
+
+int sdliv::ImageCache::invalidate(const Key & key)
+{
+	auto iter = entries.find(key);
+	if (iter == entries.end()) return 0;
+
+	erase(iter);
+	return 1;
+}
+
+
+
+
+
+int sdliv::ImageCache::invalidate(const std::string & path)
+{
+	//keys for one path are adjacent, they sort by path first
+	int count = 0;
+	auto iter = entries.lower_bound({ path, std::filesystem::file_time_type::min(), 0 });
+	while (iter != entries.end() && iter->first.path == path)
+	{
+		auto next = std::next(iter);
+		erase(iter);
+		iter = next;
+		count++;
+	}
+
+	return count;
+}
+
+
+
+
+
+int sdliv::ImageCache::clear()
+{
+	while (!entries.empty())
+	{
+		erase(entries.begin());
+	}
+
+	pin(nullptr);
+	return 0;
+}
+
+
+
+
+
+int sdliv::ImageCache::pin(Element * e)
+{
+	if (pinned_orphaned && e != pinned)
+	{
+		pinned_window->removeElement(pinned);
+		delete pinned;
+		pinned_orphaned = false;
+	}
+
+	pinned = e;
+	return 0;
+}
+
+
+
+
+
+int sdliv::ImageCache::setBudget(size_t surface_budget_bytes, size_t texture_budget_bytes)
+{
+	surface_budget = surface_budget_bytes;
+	texture_budget = texture_budget_bytes;
+
+	evict(nullptr);
+	return 0;
+}
+
+
+
+
+
+int sdliv::ImageCache::recount()
+{
+	surface_bytes = 0;
+	texture_bytes = 0;
+
+	for (auto & p : entries)
+	{
+		Entry & entry = p.second;
+		entry.surface_bytes = entry.element->getSurfaceBytes();
+		entry.texture_bytes = entry.element->getTextureBytes();
+
+		surface_bytes += entry.surface_bytes;
+		texture_bytes += entry.texture_bytes;
+	}
+
+	evict(nullptr);
+	return 0;
+}
+
+
+
+
+
+size_t sdliv::ImageCache::getSurfaceBytes() { return surface_bytes; }
+size_t sdliv::ImageCache::getTextureBytes() { return texture_bytes; }
+unsigned long sdliv::ImageCache::getHits() { return hits; }
+unsigned long sdliv::ImageCache::getMisses() { return misses; }
+
+
+
+
+
+double sdliv::ImageCache::getHitRate()
+{
+	unsigned long total = hits + misses;
+	return (total == 0) ? 0.0 : ((double) hits) / total;
+}
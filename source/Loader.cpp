@@ -0,0 +1,263 @@
+#include <sdliv.h>
+
+
+bool sdliv::Loader::module_initialized = false;
+bool sdliv::Loader::stopping = false;
+Uint32 sdliv::Loader::event_type = (Uint32) -1;
+Uint32 sdliv::Loader::surface_format = SDL_PIXELFORMAT_UNKNOWN;
+std::vector<std::thread> sdliv::Loader::workers = std::vector<std::thread>();
+std::deque<sdliv::Loader::Job> sdliv::Loader::jobs = std::deque<sdliv::Loader::Job>();
+std::set<std::pair<int, bool>> sdliv::Loader::pending = std::set<std::pair<int, bool>>();
+std::mutex sdliv::Loader::jobs_mutex;
+std::condition_variable sdliv::Loader::jobs_cv;
+
+
+
+
+
+int sdliv::Loader::init(int thread_count, Uint32 format)
+{
+	if (module_initialized)
+	{
+		log("sdliv::Loader::init() called while already initialized");
+		return -1;
+	}
+
+	event_type = SDL_RegisterEvents(1);
+	if (event_type == (Uint32) -1)
+	{
+		log("sdliv::Loader::init() -- SDL_RegisterEvents() failed");
+		return -1;
+	}
+
+	if (thread_count <= 0)
+	{
+		//leave a core for the main thread, decoding is the heavy part
+		thread_count = (int) std::thread::hardware_concurrency() - 1;
+		if (thread_count < 1) thread_count = 1;
+		if (thread_count > 4) thread_count = 4;
+	}
+
+	stopping = false;
+	surface_format = format;
+	for (int i = 0; i < thread_count; i++)
+	{
+		workers.emplace_back(work);
+	}
+
+	module_initialized = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Loader::quit()
+{
+	if (!module_initialized)
+	{
+		log("sdliv::Loader::quit() called while module uninitialized");
+		return -1;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobs_cv.notify_all();
+
+	for (auto & t : workers)
+	{
+		t.join();
+	}
+	workers.clear();
+
+	//free surfaces that were delivered but never consumed
+	SDL_Event e;
+	while (SDL_PeepEvents(&e, 1, SDL_GETEVENT, event_type, event_type) > 0)
+	{
+		Result * r = (Result*) e.user.data1;
+		if (r->surface != nullptr) SDL_FreeSurface(r->surface);
+		if (r->fitted != nullptr) SDL_FreeSurface(r->fitted);
+		delete r;
+	}
+
+	pending.clear();
+	module_initialized = false;
+
+	return 0;
+}
+
+
+
+
+
+bool sdliv::Loader::isInit()
+{
+	return module_initialized;
+}
+
+
+
+
+
+Uint32 sdliv::Loader::getEventType()
+{
+	return event_type;
+}
+
+
+
+
+
+void sdliv::Loader::work()
+{
+	perf::setThreadName("Loader");
+
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(jobs_mutex);
+			jobs_cv.wait(lock, []{ return stopping || !jobs.empty(); });
+
+			if (stopping) return;
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		Result * r = new Result{ nullptr, 0, 0, job.exact, nullptr };
+		{
+			perf::Span span(job.exact ? "Loader::resample" : "Loader::decode", job.id);
+			r->surface = Decoder::decode(job.path, job.target_width, job.target_height,
+					&r->full_width, &r->full_height, surface_format);
+			if (job.exact) r->surface = Decoder::resample(r->surface, job.target_width, job.target_height);
+		}
+
+		//from the pixels already in hand, so showing it fitted doesn't
+		//take a second exact job and decode
+		if (!job.exact && r->surface != nullptr && job.fit_width > 0 && job.fit_height > 0)
+		{
+			perf::Span span("Loader::resample", job.id);
+			r->fitted = Decoder::resampleToFit(r->surface, r->full_width, r->full_height,
+					job.fit_width, job.fit_height);
+		}
+
+		SDL_Event e;
+		SDL_zero(e);
+		e.type = event_type;
+		e.user.code = job.id;
+		e.user.data1 = r;
+
+		if (SDL_PushEvent(&e) != 1)
+		{
+			log("sdliv::Loader::work() -- SDL_PushEvent() failed", SDL_GetError());
+			if (r->surface != nullptr) SDL_FreeSurface(r->surface);
+			if (r->fitted != nullptr) SDL_FreeSurface(r->fitted);
+			delete r;
+			finish(job.id, job.exact);
+		}
+	}
+}
+
+
+
+
+
+int sdliv::Loader::request(int id, const std::string & path, bool urgent,
+		int target_width, int target_height, bool exact, int fit_width, int fit_height)
+{
+	if (!module_initialized)
+	{
+		log("sdliv::Loader::request() called while module uninitialized");
+		return -1;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+
+		if (pending.count({id, exact}) > 0)
+		{
+			if (!urgent) return 1;
+
+			//already queued, move it to the front if no worker has it yet
+			for (auto iter = jobs.begin(); iter != jobs.end(); ++iter)
+			{
+				if (iter->id == id && iter->exact == exact)
+				{
+					Job job = *iter;
+					//a full size request supersedes a reduced one
+					if (!exact && (target_width <= 0 || target_height <= 0)) job.target_width = job.target_height = 0;
+					jobs.erase(iter);
+					jobs.push_front(job);
+					break;
+				}
+			}
+
+			return 1;
+		}
+
+		pending.insert({id, exact});
+
+		if (urgent) jobs.push_front({id, path, target_width, target_height, exact, fit_width, fit_height});
+		else        jobs.push_back({id, path, target_width, target_height, exact, fit_width, fit_height});
+	}
+
+	jobs_cv.notify_one();
+	return 0;
+}
+
+
+
+
+
+int sdliv::Loader::finish(int id, bool exact)
+{
+	std::lock_guard<std::mutex> lock(jobs_mutex);
+	pending.erase({id, exact});
+	return 0;
+}
+
+
+
+
+
+int sdliv::Loader::cancelAll(std::vector<int> * cancelled_ids)
+{
+	std::lock_guard<std::mutex> lock(jobs_mutex);
+
+	for (auto & job : jobs)
+	{
+		pending.erase({job.id, job.exact});
+		if (cancelled_ids != nullptr && !job.exact) cancelled_ids->push_back(job.id);
+	}
+
+	int count = (int) jobs.size();
+	jobs.clear();
+
+	return count;
+}
+
+
+
+
+
+bool sdliv::Loader::isPending(int id)
+{
+	std::lock_guard<std::mutex> lock(jobs_mutex);
+	return pending.count({id, false}) > 0;
+}
+
+
+
+
+
+int sdliv::Loader::getQueueDepth()
+{
+	std::lock_guard<std::mutex> lock(jobs_mutex);
+	return (int) jobs.size();
+}
@@ -0,0 +1,269 @@
+#include <sdliv.h>
+
+
+
+
+
+sdliv::TextElement::TextElement() : Element()
+{
+	font = nullptr;
+	atlas = nullptr;
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	placed_rect = { 0,0,0,0 };
+	placed_atlas_height = 0;
+#endif
+}
+
+
+
+
+
+sdliv::TextElement::TextElement(const TextElement & e) : Element(e)
+{
+	log("calling sdliv::TextElement::TextElement(const TextElement&)...");
+
+	font = e.font;
+	atlas = e.atlas;
+	text = e.text;
+	quads = e.quads;
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	placed_rect = { 0,0,0,0 };
+	placed_atlas_height = 0;
+#endif
+}
+
+
+
+
+
+sdliv::TextElement::~TextElement()
+{
+	//nothing to free, the glyphs are the Font's
+}
+
+
+
+
+
+int sdliv::TextElement::close()
+{
+	if (is_copy)
+	{
+		log("sdliv::TextElement::close() element is a copy of another");
+		return -1;
+	}
+
+	text.clear();
+	quads.clear();
+	atlas = nullptr;
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	vertices.clear();
+	indices.clear();
+#endif
+
+	hidden = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::TextElement::setFont(Font * f)
+{
+	font = f;
+
+	//laid out again by the next setText(), whatever the text
+	text.clear();
+	quads.clear();
+	atlas = nullptr;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::TextElement::setText(const std::string & t)
+{
+	if (atlas != nullptr && t == text) return 0;
+
+	if (font == nullptr)
+	{
+		log("sdliv::TextElement::setText() called with null font");
+		return -1;
+	}
+
+	atlas = font->getAtlas();
+	if (atlas == nullptr)
+	{
+		log("sdliv::TextElement::setText() -- the font has no atlas");
+		return -1;
+	}
+
+	int w = 0, h = 0;
+	quads.clear();
+	if (atlas->layout(t.c_str(), &quads, &w, &h))
+	{
+		quads.clear();
+		atlas = nullptr;
+		return -1;
+	}
+
+	text = t;
+
+	hidden = false;
+	width = decoded_width = w;
+	height = decoded_height = h;
+	src_rect.x = 0; src_rect.y = 0; src_rect.w = w; src_rect.h = h;
+	scale = scale_x = scale_y = 1.0;
+	dst_rect.w = w; dst_rect.h = h;
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	vertices.clear();
+#endif
+
+	return 0;
+}
+
+
+
+
+
+const std::string & sdliv::TextElement::getText() const
+{
+	return text;
+}
+
+
+
+
+
+int sdliv::TextElement::releaseSurface()
+{
+	return 0;
+}
+
+
+
+
+
+int sdliv::TextElement::restoreTexture()
+{
+	//Font::restoreTextures() brings the atlas back, the quads still fit it
+	return 0;
+}
+
+
+
+
+
+size_t sdliv::TextElement::getSurfaceBytes() const
+{
+	return 0;
+}
+
+
+
+
+
+size_t sdliv::TextElement::getTextureBytes() const
+{
+	return 0;
+}
+
+
+
+
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+int sdliv::TextElement::placeVertices()
+{
+	vertices.resize(quads.size() * 4);
+	indices.resize(quads.size() * 6);
+
+	float sx = width > 0 ? (float) dst_rect.w / width : 1.0f;
+	float sy = height > 0 ? (float) dst_rect.h / height : 1.0f;
+	float aw = (float) atlas->getWidth();
+	float ah = (float) atlas->getHeight();
+	SDL_Color white = { 255,255,255,255 };
+
+	for (size_t i = 0; i < quads.size(); i++)
+	{
+		const GlyphAtlas::Quad & q = quads[i];
+
+		float x0 = dst_rect.x + q.dst.x * sx;
+		float y0 = dst_rect.y + q.dst.y * sy;
+		float x1 = dst_rect.x + (q.dst.x + q.dst.w) * sx;
+		float y1 = dst_rect.y + (q.dst.y + q.dst.h) * sy;
+
+		float u0 = q.src.x / aw;
+		float v0 = q.src.y / ah;
+		float u1 = (q.src.x + q.src.w) / aw;
+		float v1 = (q.src.y + q.src.h) / ah;
+
+		SDL_Vertex * v = &vertices[i * 4];
+		v[0] = { { x0, y0 }, white, { u0, v0 } };
+		v[1] = { { x1, y0 }, white, { u1, v0 } };
+		v[2] = { { x1, y1 }, white, { u1, v1 } };
+		v[3] = { { x0, y1 }, white, { u0, v1 } };
+
+		int * n = &indices[i * 6];
+		int first = (int) i * 4;
+		n[0] = first; n[1] = first + 1; n[2] = first + 2;
+		n[3] = first; n[4] = first + 2; n[5] = first + 3;
+	}
+
+	placed_rect = dst_rect;
+	placed_atlas_height = atlas->getHeight();
+
+	return 0;
+}
+#endif
+
+
+
+
+
+int sdliv::TextElement::draw()
+{
+	if (renderer == nullptr || atlas == nullptr)
+	{
+		log("sdliv::TextElement::draw() called with null renderer or atlas member");
+		return -1;
+	}
+
+	if (quads.empty() || width <= 0 || height <= 0) return 0;
+
+	SDL_Texture * t = atlas->getTexture();
+	if (t == nullptr) return -1;
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	if (vertices.empty() || placed_atlas_height != atlas->getHeight()
+			|| placed_rect.x != dst_rect.x || placed_rect.y != dst_rect.y
+			|| placed_rect.w != dst_rect.w || placed_rect.h != dst_rect.h)
+	{
+		placeVertices();
+	}
+
+	return SDL_RenderGeometry(renderer, t, vertices.data(), (int) vertices.size(), indices.data(), (int) indices.size());
+#else
+	int error = 0;
+	for (const GlyphAtlas::Quad & q : quads)
+	{
+		SDL_Rect d;
+		d.x = dst_rect.x + (int) ((long) q.dst.x * dst_rect.w / width);
+		d.y = dst_rect.y + (int) ((long) q.dst.y * dst_rect.h / height);
+		d.w = (int) ((long) (q.dst.x + q.dst.w) * dst_rect.w / width) - (d.x - dst_rect.x);
+		d.h = (int) ((long) (q.dst.y + q.dst.h) * dst_rect.h / height) - (d.y - dst_rect.y);
+
+		if (SDL_RenderCopy(renderer, t, &q.src, &d)) error = -1;
+	}
+
+	return error;
+#endif
+}
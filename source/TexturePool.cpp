@@ -0,0 +1,209 @@
+#include <sdliv.h>
+
+#include <cstring>
+
+
+
+
+
+sdliv::TexturePool::TexturePool(SDL_Renderer * r, Uint32 f)
+{
+	SDL_assert(r != nullptr);
+
+	renderer = r;
+	format = f;
+	idle_bytes = 0;
+	reused = 0;
+	created = 0;
+}
+
+
+
+
+
+//copy constructor shouldn't really be used, log it!
+sdliv::TexturePool::TexturePool(const TexturePool & p)
+{
+	log("Error: call to TexturePool(const TexturePool & p)");
+
+	renderer = p.renderer;
+	format = p.format;
+	idle_bytes = 0;
+	reused = 0;
+	created = 0;
+}
+
+
+
+
+
+sdliv::TexturePool::~TexturePool()
+{
+	clear();
+}
+
+
+
+
+
+SDL_Texture * sdliv::TexturePool::acquire(int w, int h, Uint32 format)
+{
+	//most recently released first, it's the likeliest to still be warm
+	for (auto iter = idle.rbegin(); iter != idle.rend(); ++iter)
+	{
+		if (iter->width != w || iter->height != h || iter->format != format) continue;
+
+		SDL_Texture * t = iter->texture;
+		idle_bytes -= iter->bytes;
+		idle.erase(std::next(iter).base());
+
+		reused++;
+		return t;
+	}
+
+	SDL_Texture * t = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, w, h);
+	if (t == nullptr)
+	{
+		log("sdliv::TexturePool::acquire() -- SDL_CreateTexture() failed", SDL_GetError());
+		return nullptr;
+	}
+
+	SDL_SetTextureBlendMode(t, SDL_BLENDMODE_BLEND);
+
+	created++;
+	return t;
+}
+
+
+
+
+
+int sdliv::TexturePool::release(SDL_Texture * t)
+{
+	if (t == nullptr) return -1;
+
+	Uint32 format = 0;
+	int access = 0, w = 0, h = 0;
+	if (SDL_QueryTexture(t, &format, &access, &w, &h) || access != SDL_TEXTUREACCESS_STREAMING)
+	{
+		SDL_DestroyTexture(t);
+		return -1;
+	}
+
+	Idle entry;
+	entry.texture = t;
+	entry.width = w;
+	entry.height = h;
+	entry.format = format;
+	entry.bytes = (size_t) w * h * SDL_BYTESPERPIXEL(format);
+
+	idle.push_back(entry);
+	idle_bytes += entry.bytes;
+
+	//oldest go first, they're the least likely to match again
+	while (idle_bytes > constants::texture_pool_budget && !idle.empty())
+	{
+		SDL_DestroyTexture(idle.front().texture);
+		idle_bytes -= idle.front().bytes;
+		idle.pop_front();
+	}
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::TexturePool::upload(SDL_Texture * t, const SDL_Surface * s)
+{
+	SDL_assert(t != nullptr && s != nullptr);
+
+	void * pixels = nullptr;
+	int pitch = 0;
+	if (SDL_LockTexture(t, nullptr, &pixels, &pitch))
+	{
+		log("sdliv::TexturePool::upload() -- SDL_LockTexture() failed", SDL_GetError());
+		return -1;
+	}
+
+	const size_t row_bytes = (size_t) s->w * s->format->BytesPerPixel;
+
+	if (pitch == s->pitch)
+	{
+		std::memcpy(pixels, s->pixels, (size_t) pitch * s->h);
+	}
+	else
+	{
+		for (int y = 0; y < s->h; y++)
+		{
+			std::memcpy((Uint8*) pixels + (size_t) y * pitch, (const Uint8*) s->pixels + (size_t) y * s->pitch, row_bytes);
+		}
+	}
+
+	SDL_UnlockTexture(t);
+	return 0;
+}
+
+
+
+
+
+int sdliv::TexturePool::clear()
+{
+	for (Idle & entry : idle)
+	{
+		SDL_DestroyTexture(entry.texture);
+	}
+
+	idle.clear();
+	idle_bytes = 0;
+
+	return 0;
+}
+
+
+
+
+
+Uint32 sdliv::TexturePool::getFormat() const
+{
+	return format;
+}
+
+
+
+
+
+size_t sdliv::TexturePool::getIdleBytes() const
+{
+	return idle_bytes;
+}
+
+
+
+
+
+unsigned long sdliv::TexturePool::getReused() const
+{
+	return reused;
+}
+
+
+
+
+
+unsigned long sdliv::TexturePool::getCreated() const
+{
+	return created;
+}
+
+
+
+
+
+double sdliv::TexturePool::getReuseRate() const
+{
+	unsigned long total = reused + created;
+	return (total == 0) ? 0.0 : ((double) reused) / total;
+}
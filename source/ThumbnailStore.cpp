@@ -0,0 +1,706 @@
+#include <sdliv.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+
+
+static const char container_magic[8] = { 'S', 'D', 'L', 'I', 'V', 'T', 'H', 'M' };
+static const Uint32 container_version = 2;
+
+//generated thumbnails are written out in groups this big, each appended
+//to the container so they show up without waiting for the whole directory
+static const size_t flush_count = 64;
+
+
+bool sdliv::ThumbnailStore::module_initialized = false;
+Uint32 sdliv::ThumbnailStore::event_type = (Uint32) -1;
+sdliv::ThumbnailStore::Container sdliv::ThumbnailStore::mapped = { nullptr, 0, nullptr, nullptr, 0 };
+std::filesystem::path sdliv::ThumbnailStore::mapped_directory = std::filesystem::path();
+std::thread sdliv::ThumbnailStore::generator;
+bool sdliv::ThumbnailStore::stopping = false;
+bool sdliv::ThumbnailStore::working = false;
+std::atomic<bool> sdliv::ThumbnailStore::interrupted(false);
+std::deque<sdliv::ThumbnailStore::Job> sdliv::ThumbnailStore::jobs = std::deque<sdliv::ThumbnailStore::Job>();
+std::mutex sdliv::ThumbnailStore::jobs_mutex;
+std::condition_variable sdliv::ThumbnailStore::jobs_cv;
+
+
+
+
+
+int sdliv::ThumbnailStore::init()
+{
+	if (module_initialized)
+	{
+		log("sdliv::ThumbnailStore::init() called while already initialized");
+		return -1;
+	}
+
+#ifndef WIN32
+	std::error_code ec;
+	std::filesystem::create_directories(cacheDirectory(), ec);
+	if (ec)
+	{
+		log("sdliv::ThumbnailStore::init() -- can't create cache directory", cacheDirectory().string());
+		return -1;
+	}
+
+	event_type = SDL_RegisterEvents(1);
+	if (event_type == (Uint32) -1)
+	{
+		log("sdliv::ThumbnailStore::init() -- SDL_RegisterEvents() failed");
+		return -1;
+	}
+
+	stopping = false;
+	working = false;
+	interrupted = false;
+	generator = std::thread(work);
+
+	module_initialized = true;
+	return 0;
+#else
+	log("sdliv::ThumbnailStore::init() -- not supported on this platform");
+	return -1;
+#endif
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::quit()
+{
+	if (!module_initialized)
+	{
+		log("sdliv::ThumbnailStore::quit() called while module uninitialized");
+		return -1;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+		stopping = true;
+		interrupted = true;
+		jobs.clear();
+	}
+	jobs_cv.notify_all();
+	generator.join();
+
+	//free directories that were posted but never consumed
+	SDL_Event e;
+	while (SDL_PeepEvents(&e, 1, SDL_GETEVENT, event_type, event_type) > 0)
+	{
+		delete (std::string*) e.user.data1;
+	}
+
+	close();
+
+	module_initialized = false;
+	return 0;
+}
+
+
+
+
+
+bool sdliv::ThumbnailStore::isInit()
+{
+	return module_initialized;
+}
+
+
+
+
+
+Uint32 sdliv::ThumbnailStore::getEventType()
+{
+	return event_type;
+}
+
+
+
+
+
+std::filesystem::path sdliv::ThumbnailStore::cacheDirectory()
+{
+	const char * xdg = std::getenv("XDG_CACHE_HOME");
+	if (xdg != nullptr && xdg[0] == '/')
+	{
+		return std::filesystem::path(xdg) / "sdliv";
+	}
+
+	const char * home = std::getenv("HOME");
+	if (home == nullptr) home = "/tmp";
+
+	return std::filesystem::path(home) / ".cache" / "sdliv";
+}
+
+
+
+
+
+std::filesystem::path sdliv::ThumbnailStore::containerPath(const std::filesystem::path & dir)
+{
+	char name[32];
+	SDL_snprintf(name, sizeof(name), "%016llx.thumbs",
+			(unsigned long long) hashPath(dir.lexically_normal().string()));
+
+	return cacheDirectory() / name;
+}
+
+
+
+
+
+Uint64 sdliv::ThumbnailStore::hashPath(const std::string & path)
+{
+	//FNV-1a, stable across runs and processes unlike std::hash
+	Uint64 hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : path)
+	{
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::mapContainer(const std::filesystem::path & file, Container * c)
+{
+	SDL_assert(c != nullptr);
+	*c = { nullptr, 0, nullptr, nullptr, 0 };
+
+#ifndef WIN32
+	int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return 0;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header))
+	{
+		::close(fd);
+		return 0;
+	}
+
+	void * data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (data == MAP_FAILED)
+	{
+		log("sdliv::ThumbnailStore::mapContainer() -- mmap() failed", file.string());
+		return -1;
+	}
+
+	//a copy, a writer appending to the file rewrites the header in place
+	Header header;
+	std::memcpy(&header, data, sizeof(Header));
+	size_t length = (size_t) st.st_size;
+
+	if (std::memcmp(header.magic, container_magic, sizeof(container_magic)) != 0
+			|| header.version != container_version
+			|| header.thumbnail_size != (Uint32) constants::thumbnail_size
+			|| header.index_offset % 8 != 0 || header.index_offset < sizeof(Header)
+			|| header.index_offset > length
+			|| (length - header.index_offset) / sizeof(IndexEntry) < header.count)
+	{
+		//stale or foreign, it gets replaced on the next flush
+		munmap(data, length);
+		return 0;
+	}
+
+	c->data = data;
+	c->length = length;
+	c->header = (const Header*) data;
+	c->index = (const IndexEntry*) ((const char*) data + header.index_offset);
+	c->count = header.count;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+
+
+
+
+void sdliv::ThumbnailStore::unmapContainer(Container * c)
+{
+	SDL_assert(c != nullptr);
+
+#ifndef WIN32
+	if (c->data != nullptr) munmap(c->data, c->length);
+#endif
+
+	*c = { nullptr, 0, nullptr, nullptr, 0 };
+}
+
+
+
+
+
+const sdliv::ThumbnailStore::IndexEntry * sdliv::ThumbnailStore::findEntry(const Container & c, Uint64 path_hash)
+{
+	if (c.header == nullptr) return nullptr;
+
+	const IndexEntry * first = c.index;
+	const IndexEntry * last = c.index + c.count;
+	const IndexEntry * iter = std::lower_bound(first, last, path_hash,
+			[](const IndexEntry & e, Uint64 h){ return e.path_hash < h; });
+
+	if (iter == last || iter->path_hash != path_hash) return nullptr;
+
+	//don't trust an offset that runs off the end of the file
+	if (iter->offset + (Uint64) iter->width * iter->height * 4 > c.length) return nullptr;
+
+	return iter;
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::open(const std::filesystem::path & dir)
+{
+	if (!module_initialized) return -1;
+
+	close();
+
+	mapped_directory = dir;
+	return mapContainer(containerPath(dir), &mapped);
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::reload()
+{
+	if (!module_initialized) return -1;
+
+	//the old mapping stays intact until unmapped, renames don't touch it
+	Container fresh;
+	if (mapContainer(containerPath(mapped_directory), &fresh)) return -1;
+
+	unmapContainer(&mapped);
+	mapped = fresh;
+	return 0;
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::close()
+{
+	unmapContainer(&mapped);
+	mapped_directory.clear();
+	return 0;
+}
+
+
+
+
+
+bool sdliv::ThumbnailStore::lookup(const std::string & path, std::filesystem::file_time_type mtime,
+		uintmax_t size, Thumbnail * thumbnail)
+{
+	SDL_assert(thumbnail != nullptr);
+
+	const IndexEntry * e = findEntry(mapped, hashPath(path));
+	if (e == nullptr) return false;
+
+	if (e->mtime != (Sint64) mtime.time_since_epoch().count() || e->size != (Uint64) size)
+	{
+		//file changed since its thumbnail was made
+		return false;
+	}
+
+	thumbnail->pixels = (const Uint32*) ((const char*) mapped.data + e->offset);
+	thumbnail->width = (int) e->width;
+	thumbnail->height = (int) e->height;
+	thumbnail->pitch = (int) e->width * 4;
+
+	return true;
+}
+
+
+
+
+
+size_t sdliv::ThumbnailStore::getCount()
+{
+	return mapped.count;
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::request(const std::filesystem::path & dir, const std::vector<std::string> & paths)
+{
+	if (!module_initialized) return -1;
+
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex);
+
+		//only the latest directory matters, stop working on older ones;
+		//the thread takes its job off the queue, so ask it too
+		if (working || !jobs.empty()) interrupted = true;
+		jobs.clear();
+		jobs.push_back({ dir, paths });
+	}
+
+	jobs_cv.notify_one();
+	return 0;
+}
+
+
+
+
+
+void sdliv::ThumbnailStore::work()
+{
+	perf::setThreadName("ThumbnailStore");
+
+	//thumbnails are a nicety, never compete with decoding what's on screen
+	SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(jobs_mutex);
+			jobs_cv.wait(lock, []{ return stopping || !jobs.empty(); });
+
+			if (stopping) return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			working = true;
+			interrupted = false;
+		}
+
+		//what's already on disk, possibly written by another process
+		Container existing;
+		mapContainer(containerPath(job.dir), &existing);
+
+		std::vector<Generated> generated;
+
+		for (auto & path : job.paths)
+		{
+			if (interrupted) break;
+
+			std::error_code ec;
+			std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, ec);
+			if (ec) continue;
+			uintmax_t size = std::filesystem::file_size(path, ec);
+			if (ec) continue;
+
+			Uint64 hash = hashPath(path);
+			Sint64 ticks = (Sint64) mtime.time_since_epoch().count();
+
+			const IndexEntry * e = findEntry(existing, hash);
+			if (e != nullptr && e->mtime == ticks && e->size == (Uint64) size) continue;
+
+			SDL_Surface * s = nullptr;
+			{
+				perf::Span span("ThumbnailStore::generate");
+				s = generate(path);
+			}
+			if (s == nullptr) continue;
+
+			generated.push_back({ { hash, ticks, (Uint64) size, 0, (Uint32) s->w, (Uint32) s->h }, s });
+
+			if (generated.size() >= flush_count)
+			{
+				unmapContainer(&existing);
+				flush(job.dir, generated);
+				post(job.dir);
+				mapContainer(containerPath(job.dir), &existing);
+			}
+		}
+
+		unmapContainer(&existing);
+
+		if (!generated.empty())
+		{
+			flush(job.dir, generated);
+			post(job.dir);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(jobs_mutex);
+			working = false;
+		}
+	}
+}
+
+
+
+
+
+SDL_Surface * sdliv::ThumbnailStore::generate(const std::string & path)
+{
+	SDL_Surface * loaded = IMG_Load(path.c_str());
+	if (loaded == nullptr) return nullptr;
+
+	SDL_Surface * src = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(loaded);
+	if (src == nullptr) return nullptr;
+
+	int w = src->w;
+	int h = src->h;
+	const int longest = std::max(w, h);
+	if (longest > constants::thumbnail_size)
+	{
+		w = std::max(1, (int) ((long) w * constants::thumbnail_size / longest));
+		h = std::max(1, (int) ((long) h * constants::thumbnail_size / longest));
+	}
+
+	SDL_Surface * dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (dst == nullptr)
+	{
+		SDL_FreeSurface(src);
+		return nullptr;
+	}
+
+	//box filter, every source pixel counts once, so no aliasing
+	util::boxFilter((const Uint32*) src->pixels, src->w, src->h, src->pitch,
+			(Uint32*) dst->pixels, w, h, dst->pitch, 0, h);
+
+	SDL_FreeSurface(src);
+	return dst;
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::flush(const std::filesystem::path & dir, std::vector<Generated> & generated)
+{
+	int rc = 0;
+
+#ifndef WIN32
+	const std::filesystem::path file = containerPath(dir);
+	const std::string lock_path = file.string() + ".lock";
+	const std::string temp_path = file.string() + ".tmp." + std::to_string(getpid());
+
+	//writers take turns, readers never lock; they map whichever file
+	//rename() last put in place and read the header only then
+	int lock_fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0)
+	{
+		log("sdliv::ThumbnailStore::flush() -- can't lock", lock_path);
+		if (lock_fd >= 0) ::close(lock_fd);
+		for (auto & g : generated) SDL_FreeSurface(g.surface);
+		generated.clear();
+		return -1;
+	}
+
+	//read under the lock, another process may have written since we looked
+	Container existing;
+	mapContainer(file, &existing);
+
+	//new thumbnails replace old ones for the same path
+	typedef struct
+	{
+		IndexEntry entry;
+		const Uint8 * pixels;
+		size_t pitch;
+	} Record;
+
+	std::vector<Record> records;
+	records.reserve(generated.size() + existing.count);
+
+	for (auto & g : generated)
+	{
+		records.push_back({ g.entry, (const Uint8*) g.surface->pixels, (size_t) g.surface->pitch });
+	}
+
+	std::sort(records.begin(), records.end(),
+			[](const Record & a, const Record & b){ return a.entry.path_hash < b.entry.path_hash; });
+	records.erase(std::unique(records.begin(), records.end(),
+			[](const Record & a, const Record & b){ return a.entry.path_hash == b.entry.path_hash; }),
+			records.end());
+
+	const size_t fresh_count = records.size();
+	for (Uint32 i = 0; i < existing.count; i++)
+	{
+		const IndexEntry & e = existing.index[i];
+		if (findEntry(existing, e.path_hash) != &e) continue;
+
+		auto replaced = std::lower_bound(records.begin(), records.begin() + fresh_count, e.path_hash,
+				[](const Record & r, Uint64 h){ return r.entry.path_hash < h; });
+		if (replaced != records.begin() + fresh_count && replaced->entry.path_hash == e.path_hash) continue;
+
+		records.push_back({ e, (const Uint8*) existing.data + e.offset, (size_t) e.width * 4 });
+	}
+
+	Uint64 live = 0;
+	Uint64 fresh_bytes = 0;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const Uint64 bytes = (Uint64) records[i].entry.width * records[i].entry.height * 4;
+		live += bytes;
+		if (i < fresh_count) fresh_bytes += bytes;
+	}
+
+	const Uint64 index_bytes = (Uint64) records.size() * sizeof(IndexEntry);
+
+	//appending costs only the new pixels and an index, rewriting costs the
+	//whole container, so rewrite once half the file is dead to keep the
+	//total written linear in the thumbnails made
+	const bool append = existing.header != nullptr
+			&& existing.length + fresh_bytes + index_bytes + 8 <= 2 * (sizeof(Header) + live + index_bytes);
+
+	Header header;
+	std::memcpy(header.magic, container_magic, sizeof(container_magic));
+	header.version = container_version;
+	header.count = (Uint32) records.size();
+	header.thumbnail_size = (Uint32) constants::thumbnail_size;
+	header.reserved = 0;
+
+	//offsets for the pixels that get written, the rest stay where they are
+	Uint64 offset = append ? existing.length : sizeof(Header);
+	const size_t written = append ? fresh_count : records.size();
+	for (size_t i = 0; i < written; i++)
+	{
+		records[i].entry.offset = offset;
+		offset += (Uint64) records[i].entry.width * records[i].entry.height * 4;
+	}
+
+	const Uint64 pixels_end = offset;
+	header.index_offset = (offset + 7) & ~(Uint64) 7;
+
+	std::inplace_merge(records.begin(), records.begin() + fresh_count, records.end(),
+			[](const Record & a, const Record & b){ return a.entry.path_hash < b.entry.path_hash; });
+
+	std::vector<IndexEntry> index;
+	index.reserve(records.size());
+	for (auto & r : records) index.push_back(r.entry);
+
+	//the records that need writing, fresh ones are first only before the merge
+	std::vector<const Record*> pending;
+	pending.reserve(written);
+	for (auto & r : records)
+	{
+		if (!append || r.entry.offset >= existing.length) pending.push_back(&r);
+	}
+
+	std::sort(pending.begin(), pending.end(),
+			[](const Record * a, const Record * b){ return a->entry.offset < b->entry.offset; });
+
+	const char padding[8] = { 0 };
+
+	if (append)
+	{
+		//readers' mappings end before the appended bytes and the old index
+		//stays intact, so only the header write last changes what they see
+		int fd = ::open(file.c_str(), O_WRONLY | O_CLOEXEC);
+		bool ok = fd >= 0;
+
+		for (const Record * r : pending)
+		{
+			const size_t row = (size_t) r->entry.width * 4;
+			for (Uint32 y = 0; ok && y < r->entry.height; y++)
+			{
+				ok = pwrite(fd, r->pixels + y * r->pitch, row, (off_t) (r->entry.offset + (Uint64) y * row)) == (ssize_t) row;
+			}
+		}
+
+		const size_t pad = (size_t) (header.index_offset - pixels_end);
+		ok = ok && (pad == 0 || pwrite(fd, padding, pad, (off_t) pixels_end) == (ssize_t) pad);
+		ok = ok && pwrite(fd, index.data(), (size_t) index_bytes, (off_t) header.index_offset) == (ssize_t) index_bytes;
+		ok = ok && pwrite(fd, &header, sizeof(Header), 0) == (ssize_t) sizeof(Header);
+
+		if (fd >= 0) ::close(fd);
+
+		if (!ok)
+		{
+			log("sdliv::ThumbnailStore::flush() -- failed to append to", file.string());
+			rc = -1;
+		}
+	}
+
+	else
+	{
+		FILE * out = fopen(temp_path.c_str(), "wb");
+		if (out == nullptr)
+		{
+			log("sdliv::ThumbnailStore::flush() -- can't write", temp_path);
+			rc = -1;
+		}
+
+		else
+		{
+			bool ok = fwrite(&header, sizeof(Header), 1, out) == 1;
+
+			for (const Record * r : pending)
+			{
+				const size_t row = (size_t) r->entry.width * 4;
+				for (Uint32 y = 0; ok && y < r->entry.height; y++)
+				{
+					ok = fwrite(r->pixels + y * r->pitch, row, 1, out) == 1;
+				}
+			}
+
+			const size_t pad = (size_t) (header.index_offset - pixels_end);
+			ok = ok && (pad == 0 || fwrite(padding, pad, 1, out) == 1);
+			ok = ok && fwrite(index.data(), (size_t) index_bytes, 1, out) == 1;
+
+			ok = (fclose(out) == 0) && ok;
+
+			if (!ok || rename(temp_path.c_str(), file.c_str()) != 0)
+			{
+				log("sdliv::ThumbnailStore::flush() -- failed to replace", file.string());
+				unlink(temp_path.c_str());
+				rc = -1;
+			}
+		}
+	}
+
+	unmapContainer(&existing);
+	flock(lock_fd, LOCK_UN);
+	::close(lock_fd);
+#else
+	rc = -1;
+#endif
+
+	for (auto & g : generated) SDL_FreeSurface(g.surface);
+	generated.clear();
+
+	return rc;
+}
+
+
+
+
+
+int sdliv::ThumbnailStore::post(const std::filesystem::path & dir)
+{
+	SDL_Event e;
+	SDL_zero(e);
+	e.type = event_type;
+	e.user.data1 = new std::string(dir.string());
+
+	if (SDL_PushEvent(&e) != 1)
+	{
+		log("sdliv::ThumbnailStore::post() -- SDL_PushEvent() failed", SDL_GetError());
+		delete (std::string*) e.user.data1;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,517 @@
+//before sdliv.h, whose log() macro would clobber the one in math.h
+#include <cmath>
+
+#include <sdliv.h>
+
+
+
+namespace
+{
+	//w by h pixels of s from x, y as ARGB8888 at dst
+	int expandPixels(const SDL_Surface * s, int x, int y, int w, int h, Uint32 * dst, int dst_pitch)
+	{
+		const Uint8 * src = (const Uint8*) s->pixels + (size_t) y * s->pitch + (size_t) x * s->format->BytesPerPixel;
+
+		if (s->format->format == SDL_PIXELFORMAT_RGB24)
+		{
+			for (int row = 0; row < h; row++)
+			{
+				sdliv::util::rgb24ToARGB(src + (size_t) row * s->pitch,
+						(Uint32*) ((Uint8*) dst + (size_t) row * dst_pitch), (size_t) w);
+			}
+			return 0;
+		}
+
+		return SDL_ConvertPixels(w, h, s->format->format, src, s->pitch, SDL_PIXELFORMAT_ARGB8888, dst, dst_pitch);
+	}
+}
+
+
+
+
+
+sdliv::TiledElement::TiledElement() : Element()
+{
+	tile_edge = constants::tile_size;
+	tile_bytes = 0;
+	frame = 0;
+}
+
+
+
+
+
+sdliv::TiledElement::TiledElement(const TiledElement & e) : Element(e)
+{
+	log("calling sdliv::TiledElement::TiledElement(const TiledElement&)...");
+
+	//tiles and mips stay with the original
+	surface = nullptr;
+	tile_edge = e.tile_edge;
+	tile_bytes = 0;
+	frame = 0;
+}
+
+
+
+
+
+sdliv::TiledElement::~TiledElement()
+{
+	if (!is_copy) freeAll();
+}
+
+
+
+
+
+int sdliv::TiledElement::close()
+{
+	if (is_copy)
+	{
+		log("sdliv::TiledElement::close() element is a copy of another");
+		return -1;
+	}
+
+	if (mips.empty() && tiles.empty()) return -1;
+
+	freeAll();
+	hidden = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::TiledElement::freeAll()
+{
+	for (auto & p : tiles)
+	{
+		SDL_DestroyTexture(p.second.texture);
+	}
+	tiles.clear();
+	tile_bytes = 0;
+
+	freeScaled();
+
+	//mips[0] is surface
+	for (SDL_Surface * s : mips)
+	{
+		if (s != nullptr) SDL_FreeSurface(s);
+	}
+	mips.clear();
+	surface = nullptr;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::TiledElement::createFromSurface(SDL_Surface * s)
+{
+	perf::ScopedTimer timer(perf::STAGE_CREATE);
+
+	if (s == nullptr)
+	{
+		log("sdliv::TiledElement::createFromSurface() -- passed null parameter");
+		return -1;
+	}
+
+	if (renderer == nullptr)
+	{
+		log("sdliv::TiledElement::createFromSurface() called with no rendering context");
+		SDL_FreeSurface(s);
+		return -1;
+	}
+
+	freeAll();
+
+	SDL_RendererInfo info;
+	tile_edge = constants::tile_size;
+	if (SDL_GetRendererInfo(renderer, &info) == 0)
+	{
+		if (info.max_texture_width > 0) tile_edge = std::min(tile_edge, info.max_texture_width);
+		if (info.max_texture_height > 0) tile_edge = std::min(tile_edge, info.max_texture_height);
+	}
+
+	//tiles and mips expand anything SDL_ConvertPixels() can read as they
+	//go, only palettes need the whole image converted up front
+	if (SDL_ISPIXELFORMAT_INDEXED(s->format->format) || SDL_ISPIXELFORMAT_FOURCC(s->format->format))
+	{
+		perf::ScopedTimer timer(perf::STAGE_CONVERT);
+
+		SDL_Surface * converted = SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_ARGB8888, 0);
+		SDL_FreeSurface(s);
+		if (converted == nullptr)
+		{
+			log("sdliv::TiledElement::createFromSurface() -- SDL_ConvertSurfaceFormat() failed");
+			return -1;
+		}
+		s = converted;
+	}
+
+	surface = s;
+	mips.push_back(s);
+
+	hidden = false;
+	width = s->w; height = s->h;
+	decoded_width = s->w; decoded_height = s->h;
+	xpos = ypos = zpos = 0;
+	src_rect.x = 0; src_rect.y = 0; src_rect.w = width; src_rect.h = height;
+	dst_rect.x = 0; dst_rect.y = 0; dst_rect.w = width; dst_rect.h = height;
+
+	return 0;
+}
+
+
+
+
+
+int sdliv::TiledElement::releaseSurface()
+{
+	return (surface == nullptr) ? 0 : -1;
+}
+
+
+
+
+
+int sdliv::TiledElement::restoreTexture()
+{
+	if (is_copy)
+	{
+		log("sdliv::TiledElement::restoreTexture() called from copy");
+		return -1;
+	}
+
+	for (auto & p : tiles)
+	{
+		SDL_DestroyTexture(p.second.texture);
+	}
+	tiles.clear();
+	tile_bytes = 0;
+
+	freeScaled(true);
+
+	return 0;
+}
+
+
+
+
+
+size_t sdliv::TiledElement::getSurfaceBytes() const
+{
+	size_t bytes = 0;
+	for (SDL_Surface * s : mips)
+	{
+		if (s != nullptr) bytes += (size_t) s->pitch * s->h;
+	}
+
+	return bytes;
+}
+
+
+
+
+
+size_t sdliv::TiledElement::getTextureBytes() const
+{
+	return tile_bytes + scaled_bytes;
+}
+
+
+
+
+
+int sdliv::TiledElement::getTileCount() const
+{
+	return (int) tiles.size();
+}
+
+
+
+
+
+int sdliv::TiledElement::chooseLevel() const
+{
+	if (src_rect.w <= 0 || src_rect.h <= 0) return 0;
+
+	//screen pixels per decoded pixel, src_rect is in full size ones
+	double scale = std::min(((double) dst_rect.w) / src_rect.w, ((double) dst_rect.h) / src_rect.h);
+	scale *= ((double) width) / decoded_width;
+
+	//coarsest level that still has a source pixel for every screen pixel
+	int level = 0;
+	while (scale * (1 << (level + 1)) <= 1.0
+			&& (decoded_width >> (level + 1)) > 0 && (decoded_height >> (level + 1)) > 0
+			&& level < 30)
+	{
+		level++;
+	}
+
+	return level;
+}
+
+
+
+
+
+SDL_Surface * sdliv::TiledElement::getLevel(int level)
+{
+	if (mips.empty()) return nullptr;
+
+	if ((int) mips.size() <= level) mips.resize(level + 1, nullptr);
+	if (mips[level] != nullptr) return mips[level];
+
+	//straight from the nearest finer level, skipping the ones between
+	int finer = level - 1;
+	while (mips[finer] == nullptr) finer--;
+	SDL_Surface * src = mips[finer];
+
+	int w = std::max(1, decoded_width >> level);
+	int h = std::max(1, decoded_height >> level);
+
+	SDL_Surface * dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (dst == nullptr)
+	{
+		log("sdliv::TiledElement::getLevel() -- failed to create level", level);
+		return nullptr;
+	}
+
+	if (src->format->format == SDL_PIXELFORMAT_ARGB8888)
+	{
+		util::parallelFor((size_t) h, util::workerCount((size_t) h, 64), [&](size_t begin, size_t end)
+		{
+			util::boxFilter((const Uint32*) src->pixels, src->w, src->h, src->pitch,
+					(Uint32*) dst->pixels, w, h, dst->pitch, (int) begin, (int) end);
+		});
+	}
+
+	else
+	{
+		//mips[0] in its decoded format, expand just the rows under each
+		//output row so the full image never exists as ARGB8888
+		std::atomic<bool> failed(false);
+
+		util::parallelFor((size_t) h, util::workerCount((size_t) h, 64), [&](size_t begin, size_t end)
+		{
+			std::vector<Uint32> rows;
+
+			for (int y = (int) begin; y < (int) end; y++)
+			{
+				//the same rows boxFilter() would read for y
+				const int sy0 = (int) ((long) y * src->h / h);
+				const int sy1 = std::max(sy0 + 1, (int) ((long) (y + 1) * src->h / h));
+
+				rows.resize((size_t) src->w * (sy1 - sy0));
+				if (expandPixels(src, 0, sy0, src->w, sy1 - sy0, rows.data(), src->w * 4))
+				{
+					failed = true;
+					return;
+				}
+
+				util::boxFilter(rows.data(), src->w, sy1 - sy0, src->w * 4,
+						(Uint32*) ((Uint8*) dst->pixels + (size_t) y * dst->pitch), w, 1, dst->pitch, 0, 1);
+			}
+		});
+
+		if (failed)
+		{
+			log("sdliv::TiledElement::getLevel() -- SDL_ConvertPixels() failed", SDL_GetError());
+			SDL_FreeSurface(dst);
+			return nullptr;
+		}
+	}
+
+	mips[level] = dst;
+	return dst;
+}
+
+
+
+
+
+SDL_Texture * sdliv::TiledElement::getTile(int level, int column, int row)
+{
+	TileKey key = { level, column, row };
+
+	auto iter = tiles.find(key);
+	if (iter != tiles.end())
+	{
+		iter->second.last_drawn = frame;
+		return iter->second.texture;
+	}
+
+	SDL_Surface * s = getLevel(level);
+	if (s == nullptr) return nullptr;
+
+	const int size = tile_edge;
+	const int x = column * size;
+	const int y = row * size;
+	const int w = std::min(size, s->w - x);
+	const int h = std::min(size, s->h - y);
+	if (w <= 0 || h <= 0) return nullptr;
+
+	perf::ScopedTimer timer(perf::STAGE_UPLOAD);
+
+	SDL_Texture * t = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, w, h);
+	if (t == nullptr)
+	{
+		log("sdliv::TiledElement::getTile() -- SDL_CreateTexture() failed", SDL_GetError());
+		return nullptr;
+	}
+
+	const Uint8 * pixels = (const Uint8*) s->pixels + (size_t) y * s->pitch + (size_t) x * 4;
+	int pitch = s->pitch;
+
+	//only mips[0] can be in another format, expanded here a tile at a time
+	std::vector<Uint32> expanded;
+	if (s->format->format != SDL_PIXELFORMAT_ARGB8888)
+	{
+		expanded.resize((size_t) w * h);
+		if (expandPixels(s, x, y, w, h, expanded.data(), w * 4))
+		{
+			log("sdliv::TiledElement::getTile() -- SDL_ConvertPixels() failed", SDL_GetError());
+			SDL_DestroyTexture(t);
+			return nullptr;
+		}
+
+		pixels = (const Uint8*) expanded.data();
+		pitch = w * 4;
+	}
+
+	if (SDL_UpdateTexture(t, nullptr, pixels, pitch))
+	{
+		log("sdliv::TiledElement::getTile() -- SDL_UpdateTexture() failed", SDL_GetError());
+		SDL_DestroyTexture(t);
+		return nullptr;
+	}
+
+	SDL_SetTextureBlendMode(t, SDL_BLENDMODE_BLEND);
+
+	size_t bytes = (size_t) w * h * 4;
+	perf::add(perf::COUNTER_BYTES_UPLOADED, bytes);
+	tiles[key] = { t, bytes, frame };
+	tile_bytes += bytes;
+
+	return t;
+}
+
+
+
+
+
+int sdliv::TiledElement::evictTiles()
+{
+	int count = 0;
+
+	while (tile_bytes > constants::tile_texture_budget)
+	{
+		auto oldest = tiles.end();
+		for (auto iter = tiles.begin(); iter != tiles.end(); ++iter)
+		{
+			if (iter->second.last_drawn == frame) continue;
+			if (oldest == tiles.end() || iter->second.last_drawn < oldest->second.last_drawn) oldest = iter;
+		}
+
+		//everything left is on screen
+		if (oldest == tiles.end()) break;
+
+		SDL_DestroyTexture(oldest->second.texture);
+		tile_bytes -= oldest->second.bytes;
+		tiles.erase(oldest);
+		count++;
+	}
+
+	return count;
+}
+
+
+
+
+
+int sdliv::TiledElement::draw()
+{
+	if (renderer == nullptr || mips.empty())
+	{
+		log("sdliv::TiledElement::draw() called with null renderer or surface");
+		return -1;
+	}
+
+	if (src_rect.w <= 0 || src_rect.h <= 0 || dst_rect.w <= 0 || dst_rect.h <= 0) return 0;
+
+	//fitted to the window, one resampled texture does it all
+	SDL_Texture * t = findScaled();
+	if (t != nullptr) return SDL_RenderCopy(renderer, t, nullptr, &dst_rect);
+
+	frame++;
+
+	int level = chooseLevel();
+	SDL_Surface * s = getLevel(level);
+	if (s == nullptr)
+	{
+		level = 0;
+		s = mips[0];
+	}
+
+	//src_rect is in full size pixels, scale it to the level
+	const double lx = ((double) s->w) / width;
+	const double ly = ((double) s->h) / height;
+	const double sx0 = src_rect.x * lx;
+	const double sy0 = src_rect.y * ly;
+	const double sx1 = (src_rect.x + src_rect.w) * lx;
+	const double sy1 = (src_rect.y + src_rect.h) * ly;
+
+	//level pixels to window pixels
+	const double kx = dst_rect.w / (sx1 - sx0);
+	const double ky = dst_rect.h / (sy1 - sy0);
+
+	const int size = tile_edge;
+	const int first_column = std::max(0, (int) std::floor(sx0) / size);
+	const int first_row = std::max(0, (int) std::floor(sy0) / size);
+	const int last_column = std::min((s->w - 1) / size, (int) std::ceil(sx1 - 1) / size);
+	const int last_row = std::min((s->h - 1) / size, (int) std::ceil(sy1 - 1) / size);
+
+	int error = 0;
+
+	for (int row = first_row; row <= last_row; row++)
+	{
+		for (int column = first_column; column <= last_column; column++)
+		{
+			SDL_Texture * t = getTile(level, column, row);
+			if (t == nullptr)
+			{
+				error = -1;
+				continue;
+			}
+
+			//part of this tile under src_rect, in level pixels
+			const int tx = column * size;
+			const int ty = row * size;
+			const int x0 = std::max(tx, (int) std::floor(sx0));
+			const int y0 = std::max(ty, (int) std::floor(sy0));
+			const int x1 = std::min(std::min(tx + size, s->w), (int) std::ceil(sx1));
+			const int y1 = std::min(std::min(ty + size, s->h), (int) std::ceil(sy1));
+			if (x1 <= x0 || y1 <= y0) continue;
+
+			//neighbouring tiles round a shared edge the same way, no seams
+			const int dx0 = dst_rect.x + (int) std::lround((x0 - sx0) * kx);
+			const int dy0 = dst_rect.y + (int) std::lround((y0 - sy0) * ky);
+			const int dx1 = dst_rect.x + (int) std::lround((x1 - sx0) * kx);
+			const int dy1 = dst_rect.y + (int) std::lround((y1 - sy0) * ky);
+
+			SDL_Rect src = { x0 - tx, y0 - ty, x1 - x0, y1 - y0 };
+			SDL_Rect dst = { dx0, dy0, dx1 - dx0, dy1 - dy0 };
+
+			if (SDL_RenderCopy(renderer, t, &src, &dst)) error = -1;
+		}
+	}
+
+	evictTiles();
+
+	return error;
+}
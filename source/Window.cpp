@@ -55,6 +55,7 @@ sdliv::Window::Window()
 {
 	window = nullptr;
 	renderer = nullptr;
+	texture_pool = nullptr;
 
 	//initialize window
 	window = SDL_CreateWindow(constants::window_title,
@@ -69,7 +70,14 @@ sdliv::Window::Window()
 			window,
 			-1,
 			SDL_RENDERER_ACCELERATED);
+	if (renderer == nullptr)
+	{
+		//no GPU, or a headless run under SDL_VIDEODRIVER=dummy
+		log("sdliv::Window::Window() -- no accelerated renderer, falling back to software", SDL_GetError());
+		renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+	}
 	SDL_assert(renderer != nullptr);
+	texture_pool = new TexturePool(renderer, getNativeFormat());
 
 	//handle accounting and set defaults
 	RegisterWindow(this);
@@ -85,7 +93,7 @@ sdliv::Window::Window()
 //copy constructor shouldn't really be used, log it!
 sdliv::Window::Window(const sdliv::Window & w)
 {
-	sdliv::log("Error: call to Window(const Window & w)");
+	log("Error: call to Window(const Window & w)");
 }
 
 
@@ -99,6 +107,10 @@ sdliv::Window::~Window()
 		p.second->close();
 		delete p.second;
 	}
+
+	log("sdliv::Window::~Window() -- texture pool reused", (int) texture_pool->getReused(),
+			"of", (int) (texture_pool->getReused() + texture_pool->getCreated()), "textures");
+	delete texture_pool;
 }
 
 
@@ -141,6 +153,13 @@ SDL_Window * sdliv::Window::getWindow() const
 
 
 
+sdliv::TexturePool * sdliv::Window::getTexturePool()
+{
+	return texture_pool;
+}
+
+
+
 int sdliv::Window::setSize(int w, int h)
 {
 	SDL_assert(window != nullptr);
@@ -159,6 +178,7 @@ sdliv::Element* sdliv::Window::createElement(int layer)
 	Element *element = new Element();
 
 	element->setRenderingContext(renderer);
+	element->setTexturePool(texture_pool);
 	element->setLayer(layer);
 	elements[element->getID()] = element;
 
@@ -169,11 +189,120 @@ sdliv::Element* sdliv::Window::createElement(int layer)
 
 
 
+sdliv::TiledElement* sdliv::Window::createTiledElement(int layer)
+{
+	SDL_assert(renderer != nullptr);
+
+	TiledElement *element = new TiledElement();
+
+	element->setRenderingContext(renderer);
+	element->setTexturePool(texture_pool);
+	element->setLayer(layer);
+	elements[element->getID()] = element;
+
+	layers[layer][element->getID()] = element;
+
+	return element;
+}
+
+
+
+sdliv::TextElement* sdliv::Window::createTextElement(Font * f, int layer)
+{
+	SDL_assert(renderer != nullptr);
+
+	TextElement *element = new TextElement();
+
+	element->setRenderingContext(renderer);
+	element->setFont(f);
+	element->setLayer(layer);
+	elements[element->getID()] = element;
+
+	layers[layer][element->getID()] = element;
+
+	return element;
+}
+
+
+
+sdliv::Element* sdliv::Window::createElementFor(const SDL_Surface * s, int layer)
+{
+	SDL_assert(s != nullptr);
+
+	int max_w = getMaxTextureWidth();
+	int max_h = getMaxTextureHeight();
+
+	if ((max_w > 0 && s->w > max_w) || (max_h > 0 && s->h > max_h))
+	{
+		return createTiledElement(layer);
+	}
+
+	return createElement(layer);
+}
+
+
+
+Uint32 sdliv::Window::getNativeFormat() const
+{
+	SDL_assert(renderer != nullptr);
+
+	SDL_RendererInfo info;
+	if (SDL_GetRendererInfo(renderer, &info))
+	{
+		log("sdliv::Window::getNativeFormat() -- SDL_GetRendererInfo() failed", SDL_GetError());
+		return SDL_PIXELFORMAT_ARGB8888;
+	}
+
+	//formats come in the renderer's order of preference
+	for (Uint32 i = 0; i < info.num_texture_formats; i++)
+	{
+		Uint32 f = info.texture_formats[i];
+		if (f == SDL_PIXELFORMAT_ARGB8888 || f == SDL_PIXELFORMAT_ABGR8888) return f;
+	}
+
+	return SDL_PIXELFORMAT_ARGB8888;
+}
+
+
+
+int sdliv::Window::getMaxTextureWidth() const
+{
+	SDL_assert(renderer != nullptr);
+
+	SDL_RendererInfo info;
+	if (SDL_GetRendererInfo(renderer, &info))
+	{
+		log("sdliv::Window::getMaxTextureWidth() -- SDL_GetRendererInfo() failed", SDL_GetError());
+		return 0;
+	}
+
+	return info.max_texture_width;
+}
+
+
+
+int sdliv::Window::getMaxTextureHeight() const
+{
+	SDL_assert(renderer != nullptr);
+
+	SDL_RendererInfo info;
+	if (SDL_GetRendererInfo(renderer, &info))
+	{
+		log("sdliv::Window::getMaxTextureHeight() -- SDL_GetRendererInfo() failed", SDL_GetError());
+		return 0;
+	}
+
+	return info.max_texture_height;
+}
+
+
+
 int sdliv::Window::addElement(sdliv::Element * e, int layer)
 {
 	SDL_assert(e->getRenderingContext() != nullptr);
 
 	e->setRenderingContext(renderer);
+	e->setTexturePool(texture_pool);
 	elements[e->getID()] = e;
 	layers[layer][e->getID()] = e;
 
@@ -210,14 +339,45 @@ int sdliv::Window::changeElementLayer(sdliv::Element * e, int layer)
 
 
 
-int sdliv::Window::resizeElement(Element * e)
+int sdliv::Window::restoreTextures()
 {
+	int error = 0;
+
+	//idle pooled textures went with the device
+	texture_pool->clear();
+
+	for (auto & p : elements)
+	{
+		if (p.second->restoreTexture()) error = -1;
+	}
+
+	return error;
+}
+
+
+
+
+
+double sdliv::Window::getFitScale(const Element * e) const
+{
+	SDL_assert(e != nullptr);
+
 	double x_scale = ((double) getWidth()) / ((double) e->getWidth());
 	double y_scale = ((double) getHeight()) / ((double) e->getHeight());
 
-	double scale = (x_scale < y_scale) ? x_scale : y_scale;
+	return (x_scale < y_scale) ? x_scale : y_scale;
+}
+
+
 
-	return e->setDrawScale(scale);
+
+
+int sdliv::Window::resizeElement(Element * e)
+{
+	//a previous viewElement() may have cropped it
+	e->setSourceRect({ 0, 0, e->getWidth(), e->getHeight() });
+
+	return e->setDrawScale(getFitScale(e));
 }
 
 
@@ -238,6 +398,67 @@ int sdliv::Window::centerElement(Element * e)
 
 
 
+int sdliv::Window::viewElement(Element * e, double zoom, double * center_x, double * center_y)
+{
+	SDL_assert(e != nullptr);
+	SDL_assert(center_x != nullptr && center_y != nullptr);
+
+	if (zoom < 0.00001)
+	{
+		log("sdliv::Window::viewElement() called with very small zoom");
+		return -1;
+	}
+
+	SDL_Rect src;
+	SDL_Rect dst;
+
+	//one axis at a time, they're independent
+	const int window_size[2] = { getWidth(), getHeight() };
+	const int image_size[2] = { e->getWidth(), e->getHeight() };
+	double * center[2] = { center_x, center_y };
+	int * src_pos[2] = { &src.x, &src.y };
+	int * src_len[2] = { &src.w, &src.h };
+	int * dst_pos[2] = { &dst.x, &dst.y };
+	int * dst_len[2] = { &dst.w, &dst.h };
+
+	for (int axis = 0; axis < 2; axis++)
+	{
+		const double visible = window_size[axis] / zoom; //image pixels across the window
+
+		if (visible >= image_size[axis])
+		{
+			//all of it fits, centre it
+			*center[axis] = image_size[axis] / 2.0;
+			*src_pos[axis] = 0;
+			*src_len[axis] = image_size[axis];
+			*dst_len[axis] = (int) (image_size[axis] * zoom + 0.5);
+			*dst_pos[axis] = (window_size[axis] - *dst_len[axis]) / 2;
+			continue;
+		}
+
+		//keep the window on the image
+		*center[axis] = std::min(std::max(*center[axis], visible / 2), image_size[axis] - visible / 2);
+
+		//whole source pixels covering the window, the partly visible ones
+		//at the edges hang off it by less than a pixel
+		const double first = *center[axis] - visible / 2;
+		const int begin = (int) first;
+		const int end = std::min(image_size[axis], (int) (first + visible) + 1);
+
+		*src_pos[axis] = begin;
+		*src_len[axis] = end - begin;
+		*dst_pos[axis] = -(int) ((first - begin) * zoom + 0.5);
+		*dst_len[axis] = (int) (*src_len[axis] * zoom + 0.5);
+	}
+
+	e->setSourceRect(src);
+	e->setDrawRect(dst);
+
+	return 0;
+}
+
+
+
 //iterate over key-value pairs in elements to update all Element objects
 int sdliv::Window::updateAll()
 {
@@ -344,6 +565,7 @@ int sdliv::Window::drawElement(sdliv::Element * e) //draws one element
 {
 	SDL_assert(e != nullptr);
 
+	perf::ScopedTimer timer(perf::STAGE_DRAW);
 	e->draw();
 
 	return 0;
@@ -357,6 +579,7 @@ int sdliv::Window::drawElement(const int ID)
 	SDL_assert(elements.count(ID) > 0);
 	SDL_assert(elements[ID] != nullptr);
 
+	perf::ScopedTimer timer(perf::STAGE_DRAW);
 	elements[ID]->draw();
 
 	return 0;
@@ -367,6 +590,7 @@ int sdliv::Window::drawElement(const int ID)
 //present screen updates on display
 int sdliv::Window::present()
 {
+	perf::ScopedTimer timer(perf::STAGE_PRESENT);
 	SDL_RenderPresent(renderer);
 
 	return 0;
@@ -0,0 +1,203 @@
+#include <sdliv.h>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+//	sdliv_bench [-o out.json] [-s WIDTHxHEIGHT] directory
+//
+//	steps through every image in directory the way the viewer does on
+//	the right arrow key, fitted and drawn once each, and reports the
+//	time spent in each pipeline stage as JSON
+//	meant to run headless, under SDL_VIDEODRIVER=dummy, where the
+//	Window falls back to the software renderer
+//	the Loader isn't started so every stage runs here on the main
+//	thread, and the timings add up to the wall clock
+
+
+
+static int peakRSS()
+{
+#ifndef WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) return (int) usage.ru_maxrss;
+#endif
+	return -1;
+}
+
+
+
+//quoted and escaped for JSON, control characters dropped
+static void writeString(FILE * out, const char * s)
+{
+	fputc('"', out);
+	for (; *s != '\0'; s++)
+	{
+		if (*s == '"' || *s == '\\') fputc('\\', out);
+		if ((unsigned char) *s >= 0x20) fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+
+
+static int addSupport()
+{
+	int flags = IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF;
+	int final_flags = IMG_Init(flags);
+
+	if ((final_flags & IMG_INIT_JPG) != 0) sdliv::FileHandler::addSupport(".jpg");
+	if ((final_flags & IMG_INIT_PNG) != 0) sdliv::FileHandler::addSupport(".png");
+	if ((final_flags & IMG_INIT_TIF) != 0) sdliv::FileHandler::addSupport(".tif");
+
+	return (final_flags == flags) ? 0 : -1;
+}
+
+
+
+int main(int argc, char * argv[])
+{
+	const char * out_path = nullptr;
+	const char * corpus = nullptr;
+	int width = 1280;
+	int height = 720;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		std::string a(argv[arg]);
+		if (a == "-o" && arg + 1 < argc) out_path = argv[++arg];
+		else if (a == "-s" && arg + 1 < argc) sscanf(argv[++arg], "%dx%d", &width, &height);
+		else corpus = argv[arg];
+	}
+
+	if (corpus == nullptr || width <= 0 || height <= 0)
+	{
+		fprintf(stderr, "usage: %s [-o out.json] [-s WIDTHxHEIGHT] directory\n", argv[0]);
+		return 1;
+	}
+
+	//SDLIV_TRACE works here too
+	sdliv::perf::init();
+
+	//whatever the video driver, draw in software so runs compare
+	SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS))
+	{
+		log("bench -- SDL_Init() returned error", SDL_GetError());
+		return 1;
+	}
+
+	if (addSupport())
+	{
+		log("bench -- IMG_Init() failed at least partially", IMG_GetError());
+	}
+
+	sdliv::Window * window = new sdliv::Window();
+	window->setSize(width, height);
+
+	SDL_RendererInfo info;
+	std::string renderer_name = "unknown";
+	if (SDL_GetRendererInfo(window->getRenderingContext(), &info) == 0) renderer_name = info.name;
+
+	if (sdliv::FileHandler::setWorkingDirectory(std::filesystem::path(corpus))
+			|| sdliv::FileHandler::openDirectory() < 0)
+	{
+		log("bench -- can't open directory", std::string(corpus));
+		delete window;
+		IMG_Quit();
+		SDL_Quit();
+		return 1;
+	}
+
+	//the directory scan isn't part of any stage
+	sdliv::perf::reset();
+
+	int images = 0;
+	int failed = 0;
+	double megapixels = 0.0;
+	const std::uint64_t start = sdliv::perf::now();
+
+	//files that turn out not to be images drop out as they're reached
+	for (size_t i = 0; i < sdliv::FileHandler::getTrackedCount(); i++)
+	{
+		sdliv::Element * e = (i == 0) ? sdliv::FileHandler::firstImage() : sdliv::FileHandler::nextImage();
+		if (e == nullptr)
+		{
+			failed++;
+			continue;
+		}
+
+		window->resizeElement(e);
+		window->centerElement(e);
+		window->clear();
+		window->drawElement(e);
+		window->present();
+
+		images++;
+		megapixels += ((double) e->getWidth()) * e->getHeight() / 1e6;
+	}
+
+	const double seconds = (sdliv::perf::now() - start) / 1e9;
+
+	FILE * out = (out_path != nullptr) ? fopen(out_path, "w") : stdout;
+	if (out == nullptr)
+	{
+		log("bench -- can't write", std::string(out_path));
+		out = stdout;
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"corpus\": ");
+	writeString(out, corpus);
+	fprintf(out, ",\n\t\"renderer\": ");
+	writeString(out, renderer_name.c_str());
+	fprintf(out, ",\n");
+	fprintf(out, "\t\"pixel_kernel\": \"%s\",\n", sdliv::util::pixelKernelName());
+	fprintf(out, "\t\"window\": [%d, %d],\n", width, height);
+	fprintf(out, "\t\"images\": %d,\n", images);
+	fprintf(out, "\t\"failed\": %d,\n", failed);
+	fprintf(out, "\t\"seconds\": %.6f,\n", seconds);
+	fprintf(out, "\t\"images_per_s\": %.3f,\n", (seconds > 0.0) ? images / seconds : 0.0);
+	fprintf(out, "\t\"mp_per_s\": %.3f,\n", (seconds > 0.0) ? megapixels / seconds : 0.0);
+	fprintf(out, "\t\"peak_rss_kb\": %d,\n", peakRSS());
+
+	for (int counter = 0; counter < sdliv::perf::COUNTER_COUNT; counter++)
+	{
+		fprintf(out, "\t\"%s\": %llu,\n", sdliv::perf::counterName((sdliv::perf::Counter) counter),
+				(unsigned long long) sdliv::perf::getCounter((sdliv::perf::Counter) counter));
+	}
+
+	fprintf(out, "\t\"stages\": {\n");
+
+	for (int stage = 0; stage < sdliv::perf::STAGE_COUNT; stage++)
+	{
+		sdliv::perf::Summary t = sdliv::perf::getSummary((sdliv::perf::Stage) stage);
+		fprintf(out, "\t\t\"%s\": { \"count\": %llu, \"total_ms\": %.3f, \"mean_ms\": %.3f, "
+				"\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f }%s\n",
+				sdliv::perf::stageName((sdliv::perf::Stage) stage),
+				(unsigned long long) t.count,
+				t.total_ns / 1e6,
+				(t.count > 0) ? t.total_ns / 1e6 / t.count : 0.0,
+				t.p50_ns / 1e6,
+				t.p90_ns / 1e6,
+				t.p99_ns / 1e6,
+				t.max_ns / 1e6,
+				(stage + 1 < sdliv::perf::STAGE_COUNT) ? "," : "");
+	}
+
+	fprintf(out, "\t}\n");
+	fprintf(out, "}\n");
+	if (out != stdout) fclose(out);
+
+	//the cache must let go before the window does
+	sdliv::FileHandler::untrackAll();
+	sdliv::ImageCache::clear();
+	delete window;
+
+	IMG_Quit();
+	SDL_Quit();
+
+	sdliv::perf::quit();
+	return (images > 0) ? 0 : 1;
+}
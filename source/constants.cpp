@@ -10,3 +10,22 @@ const int sdliv::constants::window_minimum_width = 100;
 const int sdliv::constants::window_minimum_height = 50;
 //const int sdliv::constants::window_update_delay_ms = 50;
 
+const int sdliv::constants::loader_thread_count = 0;
+const int sdliv::constants::prefetch_radius = 2;
+const size_t sdliv::constants::cache_surface_budget = 512 * 1024 * 1024;
+const size_t sdliv::constants::cache_texture_budget = 512 * 1024 * 1024;
+const size_t sdliv::constants::texture_pool_budget = 128 * 1024 * 1024;
+const int sdliv::constants::page_step = 10;
+const int sdliv::constants::scanner_thread_count = 4;
+const int sdliv::constants::thumbnail_size = 128;
+const int sdliv::constants::grid_cell_padding = 8;
+const int sdliv::constants::grid_layer = 2;
+const int sdliv::constants::hud_layer = 3;
+const int sdliv::constants::hud_margin = 8;
+const int sdliv::constants::glyph_atlas_size = 256;
+const int sdliv::constants::tile_size = 1024;
+const size_t sdliv::constants::tile_texture_budget = 256 * 1024 * 1024;
+const double sdliv::constants::zoom_step = 1.25;
+const double sdliv::constants::zoom_max = 32.0;
+const double sdliv::constants::full_decode_threshold = 1.0;
+const int sdliv::constants::scaled_versions = 2;
@@ -0,0 +1,195 @@
+#include <sdliv.h>
+
+
+
+
+
+namespace
+{
+	//a bounded multi producer queue, each slot's sequence number says
+	//whose turn it is; producers claim slots with a CAS on enqueue_pos,
+	//only the writer thread dequeues
+	const size_t ring_size = 1024;
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		sdliv::LogRecord record;
+	};
+
+	Slot * ring = nullptr;
+	std::atomic<size_t> enqueue_pos(0);
+	size_t dequeue_pos = 0;
+
+	//lines thrown away because the ring was full
+	std::atomic<unsigned long> dropped(0);
+
+	std::thread writer;
+	std::atomic<bool> stopping(false);
+
+	//how long the writer sleeps when there's nothing to write
+	const std::chrono::milliseconds idle_wait(5);
+
+	const char * prefixFor(int level)
+	{
+		switch (level)
+		{
+			case SDLIV_LOG_DEBUG: return "debug: ";
+			case SDLIV_LOG_ERROR: return "error: ";
+			default: return "";
+		}
+	}
+
+	void writeLine(const sdliv::LogRecord & r)
+	{
+		fputs(prefixFor(r.level), stdout);
+		fwrite(r.text, 1, r.length, stdout);
+		fputc('\n', stdout);
+	}
+
+	bool push(const sdliv::LogRecord & r)
+	{
+		size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			Slot & slot = ring[pos % ring_size];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+
+			if (diff == 0)
+			{
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					slot.record = r;
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				//full, the writer hasn't got to this slot yet
+				return false;
+			}
+			else
+			{
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//everything queued so far, one flush for the lot
+	int drain()
+	{
+		int count = 0;
+
+		while (true)
+		{
+			Slot & slot = ring[dequeue_pos % ring_size];
+			if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) break;
+
+			writeLine(slot.record);
+			slot.sequence.store(dequeue_pos + ring_size, std::memory_order_release);
+			dequeue_pos++;
+			count++;
+		}
+
+		unsigned long lost = dropped.exchange(0, std::memory_order_relaxed);
+		if (lost > 0) fprintf(stdout, "sdliv::Log -- %lu lines dropped, the log ring was full\n", lost);
+
+		if (count > 0 || lost > 0) fflush(stdout);
+		return count;
+	}
+
+	void work()
+	{
+		while (!stopping)
+		{
+			if (drain() == 0) std::this_thread::sleep_for(idle_wait);
+		}
+	}
+}
+
+
+
+
+
+std::atomic<bool> sdliv::Log::running(false);
+
+
+
+
+
+int sdliv::Log::init()
+{
+	if (running)
+	{
+		log("sdliv::Log::init() called while module already initialized");
+		return -1;
+	}
+
+	if (ring == nullptr) ring = new Slot[ring_size];
+	for (size_t i = 0; i < ring_size; i++)
+	{
+		ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	enqueue_pos = 0;
+	dequeue_pos = 0;
+
+	stopping = false;
+	writer = std::thread(work);
+
+	running = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::Log::quit()
+{
+	if (!running)
+	{
+		log("sdliv::Log::quit() called while module uninitialized");
+		return -1;
+	}
+
+	//lines logged from here on go straight out
+	running = false;
+
+	stopping = true;
+	writer.join();
+
+	//whatever was pushed while the writer was finishing up
+	drain();
+
+	return 0;
+}
+
+
+
+
+
+bool sdliv::Log::isInit()
+{
+	return running;
+}
+
+
+
+
+
+void sdliv::Log::write(const LogRecord & record)
+{
+	if (running.load(std::memory_order_acquire) && push(record)) return;
+
+	if (running.load(std::memory_order_relaxed))
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	writeLine(record);
+	fflush(stdout);
+}
@@ -11,9 +11,16 @@ int main(int argc, char * argv[])
 	sdliv::App app;
 	app.OnInit();
 
-	if (argc > 1)
+	int arg = 1;
+	if (argc > arg && std::string(argv[arg]) == "-r")
 	{
-		app.openFile(argv[1]);
+		sdliv::FileHandler::setRecursive(true);
+		arg++;
+	}
+
+	if (argc > arg)
+	{
+		app.openFile(argv[arg]);
 	}
 
 	else
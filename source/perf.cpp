@@ -0,0 +1,559 @@
+#include <sdliv.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+
+
+
+
+namespace
+{
+	const char * stage_names[sdliv::perf::STAGE_COUNT] =
+	{
+		"detect",
+		"open",
+		"decode",
+		"convert",
+		"create",
+		"upload",
+		"draw",
+		"present",
+		"scan"
+	};
+
+	const char * counter_names[sdliv::perf::COUNTER_COUNT] =
+	{
+		"bytes_decoded",
+		"bytes_uploaded"
+	};
+}
+
+
+
+
+
+const char * sdliv::perf::stageName(Stage stage)
+{
+	return (stage >= 0 && stage < STAGE_COUNT) ? stage_names[stage] : "unknown";
+}
+
+
+
+
+
+const char * sdliv::perf::counterName(Counter counter)
+{
+	return (counter >= 0 && counter < COUNTER_COUNT) ? counter_names[counter] : "unknown";
+}
+
+
+
+
+
+#ifndef SDLIV_NO_PERF
+
+namespace
+{
+	//below 4ns one bucket per value, above it four per power of two
+	const int bucket_count = 4 + 62 * 4;
+
+	//spans kept per thread, 1MB of them; older ones are overwritten
+	const std::uint64_t trace_capacity = 32 * 1024;
+
+	struct TraceEvent
+	{
+		const char * name;
+		std::uint64_t start;
+		std::uint64_t end;
+		int arg;
+	};
+
+	std::atomic<bool> tracing(false);
+	std::uint64_t trace_origin = 0;
+	std::string trace_path;
+
+	//one per thread that has timed anything, only its owner writes it,
+	//the atomics are for the readers
+	struct Shard
+	{
+		std::atomic<std::uint64_t> buckets[sdliv::perf::STAGE_COUNT][bucket_count];
+		std::atomic<std::uint64_t> totals[sdliv::perf::STAGE_COUNT];
+		std::atomic<std::uint64_t> maxima[sdliv::perf::STAGE_COUNT];
+		std::atomic<std::uint64_t> counters[sdliv::perf::COUNTER_COUNT];
+		bool in_use;
+
+		//latest timing and when it ended, the newest shard wins in getLast()
+		std::atomic<std::uint64_t> last[sdliv::perf::STAGE_COUNT];
+		std::atomic<std::uint64_t> last_end[sdliv::perf::STAGE_COUNT];
+
+		//a ring, trace_head counts every event ever written
+		std::vector<TraceEvent> trace;
+		std::atomic<std::uint64_t> trace_head;
+		std::atomic<const char *> thread_name;
+		int tid;
+
+		Shard(int id) : in_use(true), trace_head(0), thread_name(nullptr), tid(id)
+		{
+			zero();
+		}
+
+		void zero()
+		{
+			for (int i = 0; i < sdliv::perf::STAGE_COUNT; i++)
+			{
+				for (int b = 0; b < bucket_count; b++) buckets[i][b].store(0, std::memory_order_relaxed);
+				totals[i].store(0, std::memory_order_relaxed);
+				maxima[i].store(0, std::memory_order_relaxed);
+				last[i].store(0, std::memory_order_relaxed);
+				last_end[i].store(0, std::memory_order_relaxed);
+			}
+			for (int i = 0; i < sdliv::perf::COUNTER_COUNT; i++) counters[i].store(0, std::memory_order_relaxed);
+		}
+	};
+
+	//never shrinks; a thread that exits hands its Shard, counts and all,
+	//to the next one, so threads that come and go don't pile them up
+	//shards holding spans aren't handed on, or the old thread's spans
+	//would show up under the new one's name
+	std::mutex shards_mutex;
+	std::list<Shard> shards;
+
+	Shard * claimShard()
+	{
+		std::lock_guard<std::mutex> lock(shards_mutex);
+
+		for (Shard & s : shards)
+		{
+			if (s.in_use || s.trace_head.load(std::memory_order_relaxed) > 0) continue;
+			s.in_use = true;
+			s.thread_name.store(nullptr, std::memory_order_relaxed);
+			return &s;
+		}
+
+		shards.emplace_back((int) shards.size() + 1);
+		return &shards.back();
+	}
+
+	struct ShardOwner
+	{
+		Shard * shard = nullptr;
+
+		~ShardOwner()
+		{
+			if (shard == nullptr) return;
+			std::lock_guard<std::mutex> lock(shards_mutex);
+			shard->in_use = false;
+		}
+	};
+
+	thread_local ShardOwner owner;
+
+	inline Shard & localShard()
+	{
+		if (owner.shard == nullptr) owner.shard = claimShard();
+		return *owner.shard;
+	}
+
+	//single writer, a plain load and store is enough
+	inline void bump(std::atomic<std::uint64_t> & a, std::uint64_t n)
+	{
+		a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	void pushTrace(Shard & s, const char * name, std::uint64_t start, std::uint64_t end, int arg)
+	{
+		if (s.trace.empty()) s.trace.resize(trace_capacity);
+
+		std::uint64_t head = s.trace_head.load(std::memory_order_relaxed);
+		s.trace[head % trace_capacity] = { name, start, end, arg };
+		s.trace_head.store(head + 1, std::memory_order_release);
+	}
+
+	//quoted and escaped for JSON
+	void writeString(FILE * out, const char * s)
+	{
+		fputc('"', out);
+		for (; *s != '\0'; s++)
+		{
+			if (*s == '"' || *s == '\\') fputc('\\', out);
+			if ((unsigned char) *s >= 0x20) fputc(*s, out);
+		}
+		fputc('"', out);
+	}
+
+	inline int bucketOf(std::uint64_t ns)
+	{
+		if (ns < 4) return (int) ns;
+
+		int msb = 63 - __builtin_clzll(ns);
+		int sub = (int) (ns >> (msb - 2)) & 3;
+		return 4 + (msb - 2) * 4 + sub;
+	}
+
+	//middle of the range of values a bucket holds
+	inline std::uint64_t bucketValue(int bucket)
+	{
+		if (bucket < 4) return (std::uint64_t) bucket;
+
+		int msb = (bucket - 4) / 4 + 2;
+		std::uint64_t sub = (std::uint64_t) ((bucket - 4) % 4);
+		std::uint64_t low = (4 + sub) << (msb - 2);
+		std::uint64_t width = ((std::uint64_t) 1) << (msb - 2);
+		return low + width / 2;
+	}
+
+	bool module_initialized = false;
+
+#ifndef WIN32
+	std::thread signal_thread;
+	std::atomic<bool> signal_stopping(false);
+
+	void signalLoop()
+	{
+		sigset_t set;
+		sigemptyset(&set);
+		sigaddset(&set, SIGUSR1);
+
+		while (true)
+		{
+			int signal = 0;
+			if (sigwait(&set, &signal) != 0) continue;
+			if (signal_stopping) break;
+
+			sdliv::perf::dump();
+		}
+	}
+#endif
+}
+
+
+
+
+
+void sdliv::perf::record(Stage stage, std::uint64_t ns)
+{
+	Shard & s = localShard();
+	const std::uint64_t end = now();
+
+	bump(s.buckets[stage][bucketOf(ns)], 1);
+	bump(s.totals[stage], ns);
+	if (ns > s.maxima[stage].load(std::memory_order_relaxed)) s.maxima[stage].store(ns, std::memory_order_relaxed);
+
+	s.last[stage].store(ns, std::memory_order_relaxed);
+	s.last_end[stage].store(end, std::memory_order_relaxed);
+
+	if (tracing.load(std::memory_order_relaxed)) pushTrace(s, stage_names[stage], end - ns, end, -1);
+}
+
+
+
+
+
+void sdliv::perf::add(Counter counter, std::uint64_t n)
+{
+	bump(localShard().counters[counter], n);
+}
+
+
+
+
+
+sdliv::perf::Summary sdliv::perf::getSummary(Stage stage)
+{
+	Summary summary = Summary();
+	std::vector<std::uint64_t> merged(bucket_count, 0);
+
+	{
+		std::lock_guard<std::mutex> lock(shards_mutex);
+		for (Shard & s : shards)
+		{
+			for (int b = 0; b < bucket_count; b++)
+			{
+				std::uint64_t n = s.buckets[stage][b].load(std::memory_order_relaxed);
+				merged[b] += n;
+				summary.count += n;
+			}
+			summary.total_ns += s.totals[stage].load(std::memory_order_relaxed);
+			summary.max_ns = std::max(summary.max_ns, s.maxima[stage].load(std::memory_order_relaxed));
+		}
+	}
+
+	if (summary.count == 0) return summary;
+
+	//smallest value with at least that fraction of the samples at or below it
+	const double fractions[3] = { 0.50, 0.90, 0.99 };
+	std::uint64_t * results[3] = { &summary.p50_ns, &summary.p90_ns, &summary.p99_ns };
+
+	for (int i = 0; i < 3; i++)
+	{
+		std::uint64_t rank = (std::uint64_t) (fractions[i] * summary.count);
+		if (rank == 0) rank = 1;
+
+		std::uint64_t seen = 0;
+		for (int b = 0; b < bucket_count; b++)
+		{
+			seen += merged[b];
+			if (seen < rank) continue;
+
+			*results[i] = std::min(bucketValue(b), summary.max_ns);
+			break;
+		}
+	}
+
+	return summary;
+}
+
+
+
+
+
+std::uint64_t sdliv::perf::getCounter(Counter counter)
+{
+	std::uint64_t total = 0;
+
+	std::lock_guard<std::mutex> lock(shards_mutex);
+	for (Shard & s : shards)
+	{
+		total += s.counters[counter].load(std::memory_order_relaxed);
+	}
+
+	return total;
+}
+
+
+
+
+
+std::uint64_t sdliv::perf::getLast(Stage stage)
+{
+	std::uint64_t latest = 0, ns = 0;
+
+	std::lock_guard<std::mutex> lock(shards_mutex);
+	for (Shard & s : shards)
+	{
+		std::uint64_t end = s.last_end[stage].load(std::memory_order_relaxed);
+		if (end <= latest) continue;
+
+		latest = end;
+		ns = s.last[stage].load(std::memory_order_relaxed);
+	}
+
+	return ns;
+}
+
+
+
+
+
+void sdliv::perf::reset()
+{
+	std::lock_guard<std::mutex> lock(shards_mutex);
+	for (Shard & s : shards)
+	{
+		s.zero();
+	}
+}
+
+
+
+
+
+int sdliv::perf::dump(FILE * out)
+{
+	if (out == nullptr) return -1;
+
+	fprintf(out, "%-10s %10s %12s %10s %10s %10s %10s\n", "stage", "count", "total_ms", "p50_us", "p90_us", "p99_us", "max_us");
+
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		Summary s = getSummary((Stage) i);
+		if (s.count == 0) continue;
+
+		fprintf(out, "%-10s %10llu %12.3f %10.1f %10.1f %10.1f %10.1f\n",
+				stageName((Stage) i), (unsigned long long) s.count, s.total_ns / 1e6,
+				s.p50_ns / 1e3, s.p90_ns / 1e3, s.p99_ns / 1e3, s.max_ns / 1e3);
+	}
+
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		fprintf(out, "%-16s %llu\n", counterName((Counter) i), (unsigned long long) getCounter((Counter) i));
+	}
+
+	fflush(out);
+	return 0;
+}
+
+
+
+
+
+int sdliv::perf::init()
+{
+	if (module_initialized)
+	{
+		log("sdliv::perf::init() called while module already initialized");
+		return -1;
+	}
+
+	setThreadName("main");
+
+	const char * path = getenv("SDLIV_TRACE");
+	if (path != nullptr && path[0] != '\0')
+	{
+		trace_path = path;
+		trace_origin = now();
+		tracing = true;
+	}
+
+#ifndef WIN32
+	//threads inherit the mask, so only signal_thread ever takes SIGUSR1
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	if (pthread_sigmask(SIG_BLOCK, &set, nullptr) != 0)
+	{
+		//not fatal, there's just no dumping on demand
+		log("sdliv::perf::init() -- pthread_sigmask() failed");
+	}
+	else
+	{
+		signal_stopping = false;
+		signal_thread = std::thread(signalLoop);
+	}
+#endif
+
+	module_initialized = true;
+	return 0;
+}
+
+
+
+
+
+int sdliv::perf::quit()
+{
+	if (!module_initialized)
+	{
+		log("sdliv::perf::quit() called while module uninitialized");
+		return -1;
+	}
+
+#ifndef WIN32
+	//sigwait() only returns for a signal, send it one to notice the flag
+	if (signal_thread.joinable())
+	{
+		signal_stopping = true;
+		pthread_kill(signal_thread.native_handle(), SIGUSR1);
+		signal_thread.join();
+	}
+#endif
+
+	if (tracing)
+	{
+		tracing = false;
+		if (writeTrace(trace_path))
+		{
+			log("sdliv::perf::quit() -- failed to write trace", trace_path);
+		}
+	}
+
+	module_initialized = false;
+	return 0;
+}
+
+
+
+
+
+bool sdliv::perf::isInit()
+{
+	return module_initialized;
+}
+
+
+
+
+
+bool sdliv::perf::isTracing()
+{
+	return tracing.load(std::memory_order_relaxed);
+}
+
+
+
+
+
+void sdliv::perf::trace(const char * name, std::uint64_t start_ns, std::uint64_t end_ns, int arg)
+{
+	if (!tracing.load(std::memory_order_relaxed)) return;
+	pushTrace(localShard(), name, start_ns, end_ns, arg);
+}
+
+
+
+
+
+void sdliv::perf::setThreadName(const char * name)
+{
+	localShard().thread_name.store(name, std::memory_order_relaxed);
+}
+
+
+
+
+
+int sdliv::perf::writeTrace(const std::string & path)
+{
+	FILE * out = fopen(path.c_str(), "w");
+	if (out == nullptr)
+	{
+		log("sdliv::perf::writeTrace() -- can't open", path);
+		return -1;
+	}
+
+	fprintf(out, "{\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"sdliv\"}}");
+
+	std::lock_guard<std::mutex> lock(shards_mutex);
+	for (Shard & s : shards)
+	{
+		const char * name = s.thread_name.load(std::memory_order_relaxed);
+		if (name != nullptr)
+		{
+			fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", s.tid);
+			writeString(out, name);
+			fprintf(out, "}}");
+		}
+
+		if (s.trace.empty()) continue;
+
+		//the oldest still in the ring up to the newest
+		const std::uint64_t head = s.trace_head.load(std::memory_order_acquire);
+		const std::uint64_t first = (head > trace_capacity) ? head - trace_capacity : 0;
+
+		for (std::uint64_t i = first; i < head; i++)
+		{
+			const TraceEvent & e = s.trace[i % trace_capacity];
+			if (e.start < trace_origin) continue;
+
+			//complete events, microseconds since the trace started
+			fprintf(out, ",\n{\"name\":");
+			writeString(out, e.name);
+			fprintf(out, ",\"cat\":\"sdliv\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+					s.tid, (e.start - trace_origin) / 1e3, (e.end - e.start) / 1e3);
+			if (e.arg >= 0) fprintf(out, ",\"args\":{\"arg\":%d}", e.arg);
+			fprintf(out, "}");
+		}
+	}
+
+	fprintf(out, "\n]}\n");
+
+	int error = ferror(out) ? -1 : 0;
+	fclose(out);
+	return error;
+}
+
+#endif
@@ -1,8 +1,431 @@
+//before sdliv.h, whose log() macro would clobber the one in math.h
+#include <cmath>
+
 #include <sdliv.h>
 
+#include <cctype>
+
+//x86 kernels are compiled for their own instruction sets and picked at
+//run time, so the binary still runs on CPUs without them
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SDLIV_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+//SSE2 is part of x86-64, so no run time check for the resampler
+#if defined(__SSE2__) || defined(_M_X64)
+#define SDLIV_SSE2_RESAMPLE
+#include <emmintrin.h>
+#endif
+
+
+
+namespace
+{
+	//the collation key of a name, one byte at a time, so comparing two
+	//names needs no copies
+	struct KeyCursor
+	{
+		std::string_view name;
+		size_t i; //next character of name
+		size_t digit; //next digit of the run being emitted
+		size_t run_end;
+		int stage; //0 characters, 1 the length byte, 2 the digits
+
+		KeyCursor(std::string_view n) : name(n), i(0), digit(0), run_end(0), stage(0) {}
+
+		bool next(unsigned char * c)
+		{
+			if (stage == 1)
+			{
+				//the length byte makes longer numbers sort after shorter ones
+				*c = (unsigned char) ('0' + std::min<size_t>(run_end - digit, 0xff - '0'));
+				stage = 2;
+				return true;
+			}
+
+			if (stage == 2)
+			{
+				if (digit < run_end)
+				{
+					*c = name[digit++];
+					return true;
+				}
+
+				stage = 0;
+				i = run_end;
+			}
+
+			if (i >= name.size()) return false;
+
+			unsigned char ch = name[i];
+			if (!std::isdigit(ch))
+			{
+				*c = (ch < 0x80) ? (unsigned char) std::tolower(ch) : ch;
+				i++;
+				return true;
+			}
+
+			//skip leading zeros but keep one digit for a run of zeros
+			digit = i;
+			while (digit + 1 < name.size() && name[digit] == '0' && std::isdigit((unsigned char) name[digit + 1]))
+			{
+				digit++;
+			}
+
+			run_end = digit;
+			while (run_end < name.size() && std::isdigit((unsigned char) name[run_end]))
+			{
+				run_end++;
+			}
+
+			//'0' keeps numbers where digits sort in ASCII
+			*c = '0';
+			stage = 1;
+			return true;
+		}
+	};
+}
+
+
+
+int sdliv::util::naturalCompare(std::string_view a, std::string_view b)
+{
+	KeyCursor x(a), y(b);
+
+	while (true)
+	{
+		unsigned char p = 0, q = 0;
+		bool more_a = x.next(&p);
+		bool more_b = y.next(&q);
+
+		if (!more_a || !more_b) return (int) more_a - (int) more_b;
+		if (p != q) return (p < q) ? -1 : 1;
+	}
+}
+
+
+
+unsigned int sdliv::util::workerCount(size_t count, size_t min_per_thread)
+{
+	unsigned int hw = std::thread::hardware_concurrency();
+	if (hw == 0) hw = 1;
+
+	size_t wanted = (min_per_thread == 0) ? hw : count / min_per_thread;
+	if (wanted < 1) wanted = 1;
+
+	return (unsigned int) std::min<size_t>(wanted, hw);
+}
+
+
+
+void sdliv::util::boxFilter(const std::uint32_t * src, int src_w, int src_h, int src_pitch,
+		std::uint32_t * dst, int dst_w, int dst_h, int dst_pitch,
+		int row_begin, int row_end)
+{
+	for (int y = row_begin; y < row_end; y++)
+	{
+		const int sy0 = (int) ((long) y * src_h / dst_h);
+		const int sy1 = std::max(sy0 + 1, (int) ((long) (y + 1) * src_h / dst_h));
+		std::uint32_t * out = (std::uint32_t*) ((std::uint8_t*) dst + (size_t) y * dst_pitch);
+
+		for (int x = 0; x < dst_w; x++)
+		{
+			const int sx0 = (int) ((long) x * src_w / dst_w);
+			const int sx1 = std::max(sx0 + 1, (int) ((long) (x + 1) * src_w / dst_w));
+
+			std::uint32_t sum[4] = { 0, 0, 0, 0 };
+			for (int sy = sy0; sy < sy1; sy++)
+			{
+				const std::uint32_t * in = (const std::uint32_t*) ((const std::uint8_t*) src + (size_t) sy * src_pitch);
+				for (int sx = sx0; sx < sx1; sx++)
+				{
+					std::uint32_t p = in[sx];
+					sum[0] += (p >> 24) & 0xff;
+					sum[1] += (p >> 16) & 0xff;
+					sum[2] += (p >> 8) & 0xff;
+					sum[3] += p & 0xff;
+				}
+			}
+
+			const std::uint32_t n = (std::uint32_t) ((sy1 - sy0) * (sx1 - sx0));
+			out[x] = ((sum[0] / n) << 24) | ((sum[1] / n) << 16) | ((sum[2] / n) << 8) | (sum[3] / n);
+		}
+	}
+}
+
+
+
+
+void sdliv::util::boxFilterRGB24(const std::uint8_t * src, int src_w, int src_h, int src_pitch,
+		std::uint32_t * dst, int dst_w, int dst_h, int dst_pitch,
+		int row_begin, int row_end)
+{
+	std::vector<std::uint32_t> rows;
+
+	for (int y = row_begin; y < row_end; y++)
+	{
+		//the rows boxFilter() would read for y, filtered as a one row image
+		const int sy0 = (int) ((long) y * src_h / dst_h);
+		const int sy1 = std::max(sy0 + 1, (int) ((long) (y + 1) * src_h / dst_h));
+
+		rows.resize((size_t) src_w * (sy1 - sy0));
+		for (int sy = sy0; sy < sy1; sy++)
+		{
+			rgb24ToARGB(src + (size_t) sy * src_pitch, &rows[(size_t) (sy - sy0) * src_w], (size_t) src_w);
+		}
+
+		boxFilter(rows.data(), src_w, sy1 - sy0, src_w * 4,
+				(std::uint32_t*) ((std::uint8_t*) dst + (size_t) y * dst_pitch), dst_w, 1, dst_pitch, 0, 1);
+	}
+}
+
+
+
+namespace
+{
+	//source pixels under one destination pixel along one axis
+	struct Taps
+	{
+		std::vector<int> first;
+		std::vector<int> count;
+		std::vector<float> weights; //count[i] of them for each i in turn
+		std::vector<size_t> offset; //into weights
+	};
+
+	void buildTaps(int src_size, int dst_size, int begin, int end, Taps * taps)
+	{
+		const double scale = ((double) src_size) / dst_size;
+
+		for (int i = begin; i < end; i++)
+		{
+			const double a = i * scale;
+			const double b = std::min((i + 1) * scale, (double) src_size);
+			const int first = (int) a;
+			const int last = std::min(src_size - 1, std::max(first, (int) std::ceil(b) - 1));
+
+			taps->first.push_back(first);
+			taps->count.push_back(last - first + 1);
+			taps->offset.push_back(taps->weights.size());
+
+			for (int s = first; s <= last; s++)
+			{
+				const double covered = std::min(b, s + 1.0) - std::max(a, (double) s);
+				taps->weights.push_back((float) (std::max(covered, 0.0) / (b - a)));
+			}
+		}
+	}
+}
+
+
+
+void sdliv::util::areaResample(const std::uint32_t * src, int src_w, int src_h, int src_pitch,
+		std::uint32_t * dst, int dst_w, int dst_h, int dst_pitch,
+		int row_begin, int row_end)
+{
+	if (row_begin >= row_end || dst_w <= 0) return;
+
+	Taps columns, rows;
+	buildTaps(src_w, dst_w, 0, dst_w, &columns);
+	buildTaps(src_h, dst_h, row_begin, row_end, &rows);
+
+#ifdef SDLIV_SSE2_RESAMPLE
+	//all four channels of a pixel in one register, as floats
+	const __m128i zero = _mm_setzero_si128();
+	std::vector<float> sum((size_t) dst_w * 4);
+
+	for (int y = row_begin; y < row_end; y++)
+	{
+		const int r = y - row_begin;
+		std::fill(sum.begin(), sum.end(), 0.0f);
+
+		for (int k = 0; k < rows.count[r]; k++)
+		{
+			const std::uint32_t * in = (const std::uint32_t*) ((const std::uint8_t*) src + (size_t) (rows.first[r] + k) * src_pitch);
+			const __m128 wy = _mm_set1_ps(rows.weights[rows.offset[r] + k]);
+
+			for (int x = 0; x < dst_w; x++)
+			{
+				const float * wx = &columns.weights[columns.offset[x]];
+				const std::uint32_t * p = in + columns.first[x];
+
+				__m128 h = _mm_setzero_ps();
+				for (int j = 0; j < columns.count[x]; j++)
+				{
+					__m128i c = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int) p[j]), zero), zero);
+					h = _mm_add_ps(h, _mm_mul_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(wx[j])));
+				}
+
+				float * acc = &sum[4 * (size_t) x];
+				_mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), _mm_mul_ps(h, wy)));
+			}
+		}
+
+		std::uint32_t * out = (std::uint32_t*) ((std::uint8_t*) dst + (size_t) y * dst_pitch);
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (int x = 0; x < dst_w; x++)
+		{
+			__m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(&sum[4 * (size_t) x]), half));
+			c = _mm_packs_epi32(c, c);
+			out[x] = (std::uint32_t) _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+		}
+	}
+#else
+	std::vector<float> sum((size_t) dst_w * 4);
+
+	for (int y = row_begin; y < row_end; y++)
+	{
+		const int r = y - row_begin;
+		std::fill(sum.begin(), sum.end(), 0.0f);
+
+		for (int k = 0; k < rows.count[r]; k++)
+		{
+			const std::uint32_t * in = (const std::uint32_t*) ((const std::uint8_t*) src + (size_t) (rows.first[r] + k) * src_pitch);
+			const float wy = rows.weights[rows.offset[r] + k];
+
+			for (int x = 0; x < dst_w; x++)
+			{
+				const float * wx = &columns.weights[columns.offset[x]];
+				const std::uint32_t * p = in + columns.first[x];
+
+				float h[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int j = 0; j < columns.count[x]; j++)
+				{
+					for (int c = 0; c < 4; c++) h[c] += wx[j] * ((p[j] >> (8 * c)) & 0xff);
+				}
+
+				for (int c = 0; c < 4; c++) sum[4 * x + c] += wy * h[c];
+			}
+		}
+
+		std::uint32_t * out = (std::uint32_t*) ((std::uint8_t*) dst + (size_t) y * dst_pitch);
+		for (int x = 0; x < dst_w; x++)
+		{
+			std::uint32_t p = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				std::uint32_t v = (std::uint32_t) std::min(255.0f, sum[4 * x + c] + 0.5f);
+				p |= v << (8 * c);
+			}
+			out[x] = p;
+		}
+	}
+#endif
+}
+
+
+
+namespace
+{
+	typedef void (*ExpandKernel)(const std::uint8_t *, std::uint32_t *, size_t, bool);
+
+	void expandScalar(const std::uint8_t * src, std::uint32_t * dst, size_t count, bool abgr)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const std::uint32_t r = src[3 * i];
+			const std::uint32_t g = src[3 * i + 1];
+			const std::uint32_t b = src[3 * i + 2];
+
+			dst[i] = abgr ? (0xff000000u | (b << 16) | (g << 8) | r)
+					: (0xff000000u | (r << 16) | (g << 8) | b);
+		}
+	}
+
+#ifdef SDLIV_X86_KERNELS
+	//x86 is little endian, ARGB8888 is B, G, R, A in memory and ABGR8888
+	//is R, G, B, A; -1 zeroes the byte alpha is ORed into
+	__attribute__((target("ssse3")))
+	__m128i expandMask128(bool abgr)
+	{
+		return abgr ? _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1)
+				: _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	}
+
+	__attribute__((target("ssse3")))
+	void expandSSSE3(const std::uint8_t * src, std::uint32_t * dst, size_t count, bool abgr)
+	{
+		const __m128i mask = expandMask128(abgr);
+		const __m128i alpha = _mm_set1_epi32((int) 0xff000000u);
+
+		//4 pixels per 16 byte load of which 12 are used, stop while the
+		//last load is still inside src
+		size_t i = 0;
+		for (; i + 6 <= count; i += 4)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*) (src + 3 * i));
+			_mm_storeu_si128((__m128i*) (dst + i), _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha));
+		}
+
+		expandScalar(src + 3 * i, dst + i, count - i, abgr);
+	}
+
+	__attribute__((target("avx2")))
+	void expandAVX2(const std::uint8_t * src, std::uint32_t * dst, size_t count, bool abgr)
+	{
+		//vpshufb works within each 128 bit lane, so each lane gets its
+		//own 12 bytes and the same mask
+		const __m128i half = expandMask128(abgr);
+		const __m256i mask = _mm256_inserti128_si256(_mm256_castsi128_si256(half), half, 1);
+		const __m256i alpha = _mm256_set1_epi32((int) 0xff000000u);
+
+		size_t i = 0;
+		for (; i + 10 <= count; i += 8)
+		{
+			__m128i lo = _mm_loadu_si128((const __m128i*) (src + 3 * i));
+			__m128i hi = _mm_loadu_si128((const __m128i*) (src + 3 * i + 12));
+			__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			_mm256_storeu_si256((__m256i*) (dst + i), _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alpha));
+		}
+
+		expandSSSE3(src + 3 * i, dst + i, count - i, abgr);
+	}
+#endif
+
+	ExpandKernel expandKernel(const char ** name)
+	{
+#ifdef SDLIV_X86_KERNELS
+		//runs during static initialisation, before libgcc's own
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2"))
+		{
+			*name = "avx2";
+			return expandAVX2;
+		}
+
+		if (__builtin_cpu_supports("ssse3"))
+		{
+			*name = "ssse3";
+			return expandSSSE3;
+		}
+#endif
+
+		*name = "scalar";
+		return expandScalar;
+	}
+
+	const char * kernel_name = nullptr;
+	const ExpandKernel kernel = expandKernel(&kernel_name);
+}
+
+
+
+void sdliv::util::rgb24ToARGB(const std::uint8_t * src, std::uint32_t * dst, size_t count)
+{
+	kernel(src, dst, count, false);
+}
+
+
+
+void sdliv::util::rgb24ToABGR(const std::uint8_t * src, std::uint32_t * dst, size_t count)
+{
+	kernel(src, dst, count, true);
+}
+
 
 
-bool operator<(const std::string & a, const std::string & b)
+const char * sdliv::util::pixelKernelName()
 {
-	return (a.compare(b) < 0) ? true : false;
+	return kernel_name;
 }